@@ -0,0 +1,67 @@
+/**
+ * @author Douglas De Rizzo Meneghetti (douglasrizzom@gmail.com)
+ * @brief  Allocator that aligns the storage of standard containers for vectorized loops
+ * @date   2026-10-16
+ */
+
+#ifndef MACHINE_LEARNING_ALIGNEDALLOCATOR_HPP
+#define MACHINE_LEARNING_ALIGNEDALLOCATOR_HPP
+
+#include <vector>
+#include <cstdint>
+#include <new>
+
+using namespace std;
+
+
+/**
+ * Allocator whose blocks start at a multiple of <code>Alignment</code> bytes, the width of a cache line by
+ * default, so that vectorized loops over the elements of a container never split a load across two lines.
+ * @tparam T type of the allocated elements
+ * @tparam Alignment alignment of each block, in bytes. Must be a power of two
+ */
+template<typename T, size_t Alignment = 64>
+class AlignedAllocator {
+public:
+    typedef T value_type;
+
+    template<typename U>
+    struct rebind {
+        typedef AlignedAllocator<U, Alignment> other;
+    };
+
+    AlignedAllocator() {}
+
+    template<typename U>
+    AlignedAllocator(const AlignedAllocator<U, Alignment> &) {}
+
+    // ! Allocates a block with room for the elements, the alignment padding and the address of the raw block,
+    // ! which is kept right before the aligned address so deallocate() can find it
+    T *allocate(size_t n) {
+        void *raw = ::operator new(n * sizeof(T) + Alignment + sizeof(void *));
+        uintptr_t aligned = (reinterpret_cast<uintptr_t>(raw) + sizeof(void *) + Alignment - 1)
+                            & ~static_cast<uintptr_t>(Alignment - 1);
+        reinterpret_cast<void **>(aligned)[-1] = raw;
+        return reinterpret_cast<T *>(aligned);
+    }
+
+    void deallocate(T *p, size_t) {
+        ::operator delete(reinterpret_cast<void **>(p)[-1]);
+    }
+
+    template<typename U>
+    bool operator==(const AlignedAllocator<U, Alignment> &) const {
+        return true;
+    }
+
+    template<typename U>
+    bool operator!=(const AlignedAllocator<U, Alignment> &) const {
+        return false;
+    }
+};
+
+// ! Vector whose elements start at a cache line boundary
+template<typename T>
+using AlignedVector = vector<T, AlignedAllocator<T> >;
+
+#endif // MACHINE_LEARNING_ALIGNEDALLOCATOR_HPP
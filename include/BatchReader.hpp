@@ -0,0 +1,103 @@
+/**
+ * @author Douglas De Rizzo Meneghetti (douglasrizzom@gmail.com)
+ * @brief  Sources that deliver a data set in fixed-size batches of rows
+ * @date   2026-10-16
+ */
+
+#ifndef MACHINE_LEARNING_BATCHREADER_HPP
+#define MACHINE_LEARNING_BATCHREADER_HPP
+
+#include <vector>
+#include <string>
+#include <fstream>
+#include <stdexcept>
+#include "../include/matrix/Matrix.hpp"
+#include "../include/csv_reader/CSVReader.hpp"
+#include "MatrixView.hpp"
+
+using namespace std;
+
+
+/**
+ * Reads a CSV file a few rows at a time, so that files larger than the available memory can be processed.
+ * Only one batch is kept in memory at any time.
+ */
+class CSVBatchReader {
+private:
+    string path;
+    ifstream file;
+    size_t nCols;
+
+public:
+
+    // ! \param path path to a CSV file with one data element per line and no header
+    explicit CSVBatchReader(const string &path) : path(path), file(path), nCols(0) {
+        if(!file.good())
+            throw invalid_argument("File '" + path + "' doesn't exist");
+    }
+
+    // ! Reads the next rows of the file
+    // ! \param rows maximum number of rows to be read
+    // ! \param batch receives the rows that were read
+    // ! \return false if the end of the file was reached before any row could be read
+    bool next(size_t rows, MatrixD &batch) {
+        vector<double> elements, line;
+        size_t read = 0;
+
+        while(read < rows and !(line = CSVReader::csvLineToDoubles(file)).empty()) {
+            if(nCols == 0)
+                nCols = line.size();
+            else if(line.size() != nCols)
+                throw runtime_error("File has missing values in some columns");
+
+            elements.insert(elements.end(), line.begin(), line.end());
+            read++;
+        }
+
+        if(read == 0)
+            return false;
+
+        batch = MatrixD(read, nCols, elements);
+        return true;
+    }
+
+    // ! Goes back to the beginning of the file, to start a new pass over the data
+    void rewind() {
+        file.clear();
+        file.seekg(0);
+    }
+};
+
+/**
+ * Delivers the rows of a matrix already in memory in batches, with the same interface as CSVBatchReader
+ */
+class MatrixBatchReader {
+private:
+    MatrixViewD data;
+    size_t position;
+
+public:
+
+    // ! \param data the data set. It must outlive the reader
+    explicit MatrixBatchReader(MatrixViewD data) : data(data), position(0) {}
+
+    // ! \param rows maximum number of rows to be read
+    // ! \param batch receives the rows that were read
+    // ! \return false if all rows were already read
+    bool next(size_t rows, MatrixD &batch) {
+        if(position >= data.nRows())
+            return false;
+
+        size_t count = min(rows, data.nRows() - position);
+        batch = data.rows(position, count).copy();
+        position += count;
+        return true;
+    }
+
+    void rewind() {
+        position = 0;
+    }
+};
+
+
+#endif // MACHINE_LEARNING_BATCHREADER_HPP
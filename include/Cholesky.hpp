@@ -0,0 +1,147 @@
+/**
+ * @author Douglas De Rizzo Meneghetti (douglasrizzom@gmail.com)
+ * @brief  Cholesky decomposition of symmetric positive definite matrices
+ * @date   2026-10-16
+ */
+
+#ifndef MACHINE_LEARNING_CHOLESKY_HPP
+#define MACHINE_LEARNING_CHOLESKY_HPP
+
+#include <vector>
+#include <cmath>
+#include <stdexcept>
+#include "../include/matrix/Matrix.hpp"
+#include "Gemm.hpp"
+
+using namespace std;
+
+
+/**
+ * Cholesky decomposition, A = LL', of a symmetric positive definite matrix.
+ *
+ * It takes half the work of an LU decomposition and needs no pivoting, so it is the decomposition of choice for
+ * Gram, covariance and scatter matrices. Only the lower triangle of A is read. The constructor throws if A is not
+ * numerically positive definite.
+ */
+class Cholesky {
+private:
+    size_t n;
+    // L, in the lower triangle, stored row-major. The upper triangle is zero
+    vector<double> l;
+
+    double &at(size_t i, size_t j) {
+        return l[i * n + j];
+    }
+
+    double at(size_t i, size_t j) const {
+        return l[i * n + j];
+    }
+
+    void validate(const MatrixD &b) const {
+        if(b.nRows() != n)
+            throw invalid_argument(
+                "Cannot solve the system: A = " + to_string(n) + "x" + to_string(n) + ", B = "
+                + to_string(b.nRows()) + "x" + to_string(b.nCols()));
+    }
+
+public:
+
+    // ! Factorizes a symmetric positive definite matrix
+    // ! \param a the matrix to be factorized
+    explicit Cholesky(const MatrixD &a) : n(a.nRows()) {
+        if(a.nRows() != a.nCols())
+            throw runtime_error("Cannot factorize a non-square matrix");
+
+        const double *data = Gemm::data(a);
+        l.assign(n * n, 0);
+
+        for(size_t i = 0; i < n; i++)
+            for(size_t j = 0; j <= i; j++)
+                at(i, j) = data[i * n + j];
+
+        // left-looking, column by column; the entries below the diagonal of a column are independent
+        for(size_t j = 0; j < n; j++) {
+            double diagonal = at(j, j);
+
+            for(size_t k = 0; k < j; k++)
+                diagonal -= at(j, k) * at(j, k);
+
+            if(!(diagonal > 0))
+                throw runtime_error("Matrix is not positive definite");
+
+            diagonal = sqrt(diagonal);
+            at(j, j) = diagonal;
+
+            #pragma omp parallel for if((n - j) * j > 16384)
+            for(size_t i = j + 1; i < n; i++) {
+                double value = at(i, j);
+
+                for(size_t k = 0; k < j; k++)
+                    value -= at(i, k) * at(j, k);
+
+                at(i, j) = value / diagonal;
+            }
+        }
+    }
+
+    // ! Solves LX = B by forward substitution
+    // ! \param b a matrix with as many rows as A, each of its columns a right-hand side
+    MatrixD solveLower(const MatrixD &b) const {
+        validate(b);
+        size_t m = b.nCols();
+        MatrixD x = b;
+        double *xd = Gemm::data(x);
+
+        for(size_t i = 0; i < n; i++) {
+            for(size_t k = 0; k < i; k++) {
+                double lik = at(i, k);
+
+                for(size_t c = 0; c < m; c++)
+                    xd[i * m + c] -= lik * xd[k * m + c];
+            }
+
+            for(size_t c = 0; c < m; c++)
+                xd[i * m + c] /= at(i, i);
+        }
+
+        return x;
+    }
+
+    // ! Solves L'X = B by back substitution
+    // ! \param b a matrix with as many rows as A, each of its columns a right-hand side
+    MatrixD solveUpper(const MatrixD &b) const {
+        validate(b);
+        size_t m = b.nCols();
+        MatrixD x = b;
+        double *xd = Gemm::data(x);
+
+        for(size_t i = n; i-- > 0;) {
+            for(size_t c = 0; c < m; c++)
+                xd[i * m + c] /= at(i, i);
+
+            for(size_t k = 0; k < i; k++) {
+                double lik = at(i, k);
+
+                for(size_t c = 0; c < m; c++)
+                    xd[k * m + c] -= lik * xd[i * m + c];
+            }
+        }
+
+        return x;
+    }
+
+    // ! Solves the linear system AX = B, without forming the inverse of A
+    // ! \param b a matrix with as many rows as A, each of its columns a right-hand side
+    // ! \return the matrix X
+    MatrixD solve(const MatrixD &b) const {
+        return solveUpper(solveLower(b));
+    }
+
+    // ! \return the lower triangular factor L
+    MatrixD getL() const {
+        return MatrixD(n, n, l);
+    }
+};
+
+
+#endif // MACHINE_LEARNING_CHOLESKY_HPP
@@ -7,11 +7,12 @@
 #ifndef MACHINE_LEARNING_CLASSIFIERUTILS_HPP
 #define MACHINE_LEARNING_CLASSIFIERUTILS_HPP
 
+#include "MatrixView.hpp"
 
 class ClassifierUtils {
 private:
 
-    static size_t findLabel(MatrixD y, double label) {
+    static size_t findLabel(const MatrixD &y, double label) {
         for(size_t i = 0; i < y.nRows(); i++)
             if(label == y(i, 0))
                 return i;
@@ -19,17 +20,20 @@ private:
         return 0;
     }
 
-    static MatrixD getAllClasses(const MatrixD yTrue, const MatrixD yPred) {
-        MatrixD allClasses = yTrue;
-        allClasses.addColumn(yPred);
-        allClasses = allClasses.unique();
-        allClasses.sort();
-        return allClasses;
+    static MatrixD getAllClasses(MatrixViewD yTrue, MatrixViewD yPred) {
+        set<double> allClasses;
+
+        for(size_t i = 0; i < yTrue.nRows(); i++) {
+            allClasses.insert(yTrue(i, 0));
+            allClasses.insert(yPred(i, 0));
+        }
+
+        return MatrixD(allClasses.size(), 1, vector<double>(allClasses.begin(), allClasses.end()));
     }
 
 public:
 
-    static void checkLabels(const MatrixD yTrue, const MatrixD yPred) {
+    static void checkLabels(MatrixViewD yTrue, MatrixViewD yPred) {
         if(yTrue.nCols() != 1 or yPred.nCols() != 1)
             throw invalid_argument("Labels must be column vectors");
 
@@ -37,7 +41,7 @@ public:
             throw invalid_argument("True labels and predicted labels must have the same size (number of rows).");
     }
 
-    static void checkBinaryLabels(const MatrixD yTrue, const MatrixD yPred) {
+    static void checkBinaryLabels(MatrixViewD yTrue, MatrixViewD yPred) {
         checkLabels(yTrue, yPred);
 
         if(!yTrue.isBinary())
@@ -47,11 +51,17 @@ public:
             throw invalid_argument("Predicted labels must be composed of only two classes");
     }
 
-    static MatrixI binarize(MatrixD m, double trueLabel) {
-        return m == trueLabel;
+    static MatrixI binarize(MatrixViewD m, double trueLabel) {
+        MatrixI result(m.nRows(), m.nCols());
+
+        for(size_t i = 0; i < m.nRows(); i++)
+            for(size_t j = 0; j < m.nCols(); j++)
+                result(i, j) = m(i, j) == trueLabel;
+
+        return result;
     }
 
-    static MatrixI confusionMatrix(MatrixD yTrue, MatrixD yPred) {
+    static MatrixI confusionMatrix(MatrixViewD yTrue, MatrixViewD yPred) {
         checkLabels(yTrue, yPred);
 
         MatrixD allClasses = getAllClasses(yTrue, yPred);
@@ -68,7 +78,7 @@ public:
         return result;
     }
 
-    static double accuracy(MatrixD yTrue, MatrixD yPred) {
+    static double accuracy(MatrixViewD yTrue, MatrixViewD yPred) {
         checkLabels(yTrue, yPred);
         double accuracy = 0;
 
@@ -78,19 +88,19 @@ public:
         return accuracy / yTrue.nRows();
     }
 
-    static double precision(MatrixD yTrue, MatrixD yPred) {
+    static double precision(MatrixViewD yTrue, MatrixViewD yPred) {
         checkBinaryLabels(yTrue, yPred);
         MatrixI cm = confusionMatrix(yTrue, yPred);
         return cm(1, 1) / ((double) cm(1, 1) + cm(1, 0));
     }
 
-    static double recall(MatrixD yTrue, MatrixD yPred) {
+    static double recall(MatrixViewD yTrue, MatrixViewD yPred) {
         checkBinaryLabels(yTrue, yPred);
         MatrixI cm = confusionMatrix(yTrue, yPred);
         return cm(1, 1) / ((double) cm(1, 1) + cm(0, 1));
     }
 
-    static double f_score(MatrixD yTrue, MatrixD yPred) {
+    static double f_score(MatrixViewD yTrue, MatrixViewD yPred) {
         checkBinaryLabels(yTrue, yPred);
         double p = precision(yTrue, yPred), r = recall(yTrue, yPred);
         return 2 * ((p * r) / (p + r));
@@ -0,0 +1,298 @@
+/**
+ * @author Douglas De Rizzo Meneghetti (douglasrizzom@gmail.com)
+ * @brief  Expression templates that fuse chains of element-wise matrix operations into a single loop
+ * @date   2026-10-16
+ */
+
+#ifndef MACHINE_LEARNING_EXPRESSION_HPP
+#define MACHINE_LEARNING_EXPRESSION_HPP
+
+#include <stdexcept>
+#include <string>
+#include "../include/matrix/Matrix.hpp"
+#include "MatrixView.hpp"
+#include "Gemm.hpp"
+
+using namespace std;
+
+
+/**
+ * Lazy element-wise matrix arithmetic.
+ *
+ * <code>expr::lazy(m)</code> wraps a matrix (or a view of one) in an expression. Combining expressions with
+ * <code>+ - * /</code> (element-wise, or against a scalar), <code>hadamard</code>, <code>apply</code> and
+ * <code>transpose</code> only builds a small tree of nodes; no matrix is allocated until the tree is passed to
+ * <code>eval</code>, <code>assign</code> or <code>sum</code>, which compute every element of the result in one
+ * pass. Matrix products are not element-wise and must be computed with Gemm, whose result can then be wrapped in
+ * an expression.
+ *
+ * Expressions refer to the matrices they were built from, so they must be evaluated before those matrices are
+ * modified or destroyed. Usually this means building and evaluating them in the same statement.
+ */
+namespace expr {
+
+    // ! Base of all expression nodes, used to restrict the operators below to expressions
+    template<typename Derived>
+    struct Expression {
+        const Derived &self() const {
+            return static_cast<const Derived &>(*this);
+        }
+    };
+
+    struct Add {
+        static double apply(double a, double b) { return a + b; }
+    };
+
+    struct Subtract {
+        static double apply(double a, double b) { return a - b; }
+    };
+
+    struct Multiply {
+        static double apply(double a, double b) { return a * b; }
+    };
+
+    struct Divide {
+        static double apply(double a, double b) { return a / b; }
+    };
+
+    // ! Expression that reads the elements of a matrix
+    struct Leaf : public Expression<Leaf> {
+        MatrixViewD view;
+
+        explicit Leaf(MatrixViewD view) : view(view) {}
+
+        size_t nRows() const { return view.nRows(); }
+
+        size_t nCols() const { return view.nCols(); }
+
+        double operator()(size_t i, size_t j) const { return view(i, j); }
+    };
+
+    // ! Element-wise operation between two expressions of the same shape
+    template<typename Op, typename L, typename R>
+    struct Binary : public Expression<Binary<Op, L, R> > {
+        L left;
+        R right;
+
+        Binary(const L &left, const R &right, const string &name) : left(left), right(right) {
+            if(left.nRows() != right.nRows() or left.nCols() != right.nCols())
+                throw invalid_argument(
+                    "Cannot " + name + " these matrices: L = " + to_string(left.nRows()) + "x"
+                    + to_string(left.nCols()) + ", R = " + to_string(right.nRows()) + "x" + to_string(right.nCols()));
+        }
+
+        size_t nRows() const { return left.nRows(); }
+
+        size_t nCols() const { return left.nCols(); }
+
+        double operator()(size_t i, size_t j) const { return Op::apply(left(i, j), right(i, j)); }
+    };
+
+    // ! Operation between a scalar, on the left, and every element of an expression
+    template<typename Op, typename R>
+    struct ScalarLeft : public Expression<ScalarLeft<Op, R> > {
+        double scalar;
+        R right;
+
+        ScalarLeft(double scalar, const R &right) : scalar(scalar), right(right) {}
+
+        size_t nRows() const { return right.nRows(); }
+
+        size_t nCols() const { return right.nCols(); }
+
+        double operator()(size_t i, size_t j) const { return Op::apply(scalar, right(i, j)); }
+    };
+
+    // ! Operation between every element of an expression and a scalar, on the right
+    template<typename Op, typename L>
+    struct ScalarRight : public Expression<ScalarRight<Op, L> > {
+        L left;
+        double scalar;
+
+        ScalarRight(const L &left, double scalar) : left(left), scalar(scalar) {}
+
+        size_t nRows() const { return left.nRows(); }
+
+        size_t nCols() const { return left.nCols(); }
+
+        double operator()(size_t i, size_t j) const { return Op::apply(left(i, j), scalar); }
+    };
+
+    // ! Applies a function to every element of an expression
+    template<typename F, typename E>
+    struct Apply : public Expression<Apply<F, E> > {
+        F f;
+        E inner;
+
+        Apply(const F &f, const E &inner) : f(f), inner(inner) {}
+
+        size_t nRows() const { return inner.nRows(); }
+
+        size_t nCols() const { return inner.nCols(); }
+
+        double operator()(size_t i, size_t j) const { return f(inner(i, j)); }
+    };
+
+    // ! Transpose of an expression
+    template<typename E>
+    struct Transpose : public Expression<Transpose<E> > {
+        E inner;
+
+        explicit Transpose(const E &inner) : inner(inner) {}
+
+        size_t nRows() const { return inner.nCols(); }
+
+        size_t nCols() const { return inner.nRows(); }
+
+        double operator()(size_t i, size_t j) const { return inner(j, i); }
+    };
+
+    // ! \return an expression that reads the elements of <code>m</code>
+    inline Leaf lazy(MatrixViewD m) {
+        return Leaf(m);
+    }
+
+    // region Element-wise operators
+
+    template<typename L, typename R>
+    Binary<Add, L, R> operator+(const Expression<L> &l, const Expression<R> &r) {
+        return Binary<Add, L, R>(l.self(), r.self(), "add");
+    }
+
+    template<typename L, typename R>
+    Binary<Subtract, L, R> operator-(const Expression<L> &l, const Expression<R> &r) {
+        return Binary<Subtract, L, R>(l.self(), r.self(), "subtract");
+    }
+
+    // ! Element-wise division
+    template<typename L, typename R>
+    Binary<Divide, L, R> operator/(const Expression<L> &l, const Expression<R> &r) {
+        return Binary<Divide, L, R>(l.self(), r.self(), "divide");
+    }
+
+    // ! Element-wise (Hadamard) product
+    template<typename L, typename R>
+    Binary<Multiply, L, R> hadamard(const Expression<L> &l, const Expression<R> &r) {
+        return Binary<Multiply, L, R>(l.self(), r.self(), "multiply");
+    }
+
+    // endregion
+
+    // region Scalar operators
+
+    template<typename E>
+    ScalarLeft<Add, E> operator+(double value, const Expression<E> &e) {
+        return ScalarLeft<Add, E>(value, e.self());
+    }
+
+    template<typename E>
+    ScalarRight<Add, E> operator+(const Expression<E> &e, double value) {
+        return ScalarRight<Add, E>(e.self(), value);
+    }
+
+    template<typename E>
+    ScalarLeft<Subtract, E> operator-(double value, const Expression<E> &e) {
+        return ScalarLeft<Subtract, E>(value, e.self());
+    }
+
+    template<typename E>
+    ScalarRight<Subtract, E> operator-(const Expression<E> &e, double value) {
+        return ScalarRight<Subtract, E>(e.self(), value);
+    }
+
+    template<typename E>
+    ScalarLeft<Multiply, E> operator*(double value, const Expression<E> &e) {
+        return ScalarLeft<Multiply, E>(value, e.self());
+    }
+
+    template<typename E>
+    ScalarRight<Multiply, E> operator*(const Expression<E> &e, double value) {
+        return ScalarRight<Multiply, E>(e.self(), value);
+    }
+
+    template<typename E>
+    ScalarLeft<Divide, E> operator/(double value, const Expression<E> &e) {
+        return ScalarLeft<Divide, E>(value, e.self());
+    }
+
+    template<typename E>
+    ScalarRight<Divide, E> operator/(const Expression<E> &e, double value) {
+        return ScalarRight<Divide, E>(e.self(), value);
+    }
+
+    template<typename E>
+    ScalarLeft<Multiply, E> operator-(const Expression<E> &e) {
+        return ScalarLeft<Multiply, E>(-1, e.self());
+    }
+
+    // endregion
+
+    // ! Applies a function to every element of an expression
+    // ! \param f a function pointer or function object taking and returning a double
+    // ! \param e an expression
+    template<typename F, typename E>
+    Apply<F, E> apply(F f, const Expression<E> &e) {
+        return Apply<F, E>(f, e.self());
+    }
+
+    // ! \return the transpose of an expression. Evaluating it while assigning to one of its operands is not safe
+    template<typename E>
+    Transpose<E> transpose(const Expression<E> &e) {
+        return Transpose<E>(e.self());
+    }
+
+    // ! Evaluates an expression into a new matrix, in a single pass over its elements
+    template<typename E>
+    MatrixD eval(const Expression<E> &e) {
+        const E &x = e.self();
+        size_t rows = x.nRows(), cols = x.nCols();
+        MatrixD result(rows, cols);
+        double *out = Gemm::data(result);
+
+        #pragma omp parallel for if(rows * cols > 65536)
+        for(size_t i = 0; i < rows; i++)
+            for(size_t j = 0; j < cols; j++)
+                out[i * cols + j] = x(i, j);
+
+        return result;
+    }
+
+    // ! Evaluates an expression directly into an existing matrix, reusing its storage when it already has the
+    // ! shape of the result. The destination may appear in the expression, as long as it is not transposed
+    // ! \param destination matrix that will receive the result
+    // ! \param e an expression
+    template<typename E>
+    void assign(MatrixD &destination, const Expression<E> &e) {
+        const E &x = e.self();
+        size_t rows = x.nRows(), cols = x.nCols();
+
+        if(destination.nRows() != rows or destination.nCols() != cols) {
+            destination = eval(e);
+            return;
+        }
+
+        double *out = Gemm::data(destination);
+
+        #pragma omp parallel for if(rows * cols > 65536)
+        for(size_t i = 0; i < rows; i++)
+            for(size_t j = 0; j < cols; j++)
+                out[i * cols + j] = x(i, j);
+    }
+
+    // ! \return the sum of all elements of an expression, computed without materializing it
+    template<typename E>
+    double sum(const Expression<E> &e) {
+        const E &x = e.self();
+        size_t rows = x.nRows(), cols = x.nCols();
+        double total = 0;
+
+        #pragma omp parallel for reduction(+:total) if(rows * cols > 65536)
+        for(size_t i = 0; i < rows; i++)
+            for(size_t j = 0; j < cols; j++)
+                total += x(i, j);
+
+        return total;
+    }
+}
+
+#endif // MACHINE_LEARNING_EXPRESSION_HPP
@@ -0,0 +1,322 @@
+/**
+ * @author Douglas De Rizzo Meneghetti (douglasrizzom@gmail.com)
+ * @brief  Cache-blocked, register-tiled general matrix multiplication
+ * @date   2026-10-16
+ */
+
+#ifndef MACHINE_LEARNING_GEMM_HPP
+#define MACHINE_LEARNING_GEMM_HPP
+
+#include <vector>
+#include <algorithm>
+#include <stdexcept>
+#include <string>
+#include "../include/matrix/Matrix.hpp"
+#include "MatrixView.hpp"
+#include "Workspace.hpp"
+
+using namespace std;
+
+
+/**
+ * General matrix multiplication engine, computing C = alpha * A * B + beta * C.
+ *
+ * Operands are addressed by a pointer plus a row and a column stride, so transposed operands are read in place.
+ * A and B are packed into panels sized for the L2 and L1 caches, and every MR x NR tile of C is computed by an
+ * unrolled micro-kernel that keeps its accumulators in registers. Blocks of rows and columns of C are distributed
+ * among OpenMP threads in two dimensions. Packing buffers are kept by each thread between calls.
+ */
+class Gemm {
+private:
+    // register tile (MR x NR), rows of A packed per L2 block (MC), depth of a packed panel (KC),
+    // columns of B packed per L3 block (NC) and columns of C assigned to a thread at a time (NB)
+    enum { MR = 4, NR = 8, MC = 128, KC = 256, NC = 4096, NB = 256 };
+    // rows of A shifted at a time by multiplyShifted()
+    enum { ROW_TILE = 256 };
+
+    // ! Copies an mc x kc block of A into micro-panels of MR rows, zero-padding the last one
+    template<typename T>
+    static void packA(size_t mc, size_t kc, const T *a, size_t rsa, size_t csa, T *buffer) {
+        for(size_t ir = 0; ir < mc; ir += MR) {
+            size_t mr = min<size_t>(MR, mc - ir);
+
+            for(size_t p = 0; p < kc; p++) {
+                for(size_t i = 0; i < mr; i++)
+                    *buffer++ = a[(ir + i) * rsa + p * csa];
+
+                for(size_t i = mr; i < MR; i++)
+                    *buffer++ = 0;
+            }
+        }
+    }
+
+    // ! Copies the NR-column micro-panel starting at column jr of a kc x nc block of B, zero-padding it
+    template<typename T>
+    static void packB(size_t kc, size_t nc, size_t jr, const T *b, size_t rsb, size_t csb, T *buffer) {
+        size_t nr = min<size_t>(NR, nc - jr);
+        buffer += jr * kc;
+
+        for(size_t p = 0; p < kc; p++) {
+            for(size_t j = 0; j < nr; j++)
+                *buffer++ = b[p * rsb + (jr + j) * csb];
+
+            for(size_t j = nr; j < NR; j++)
+                *buffer++ = 0;
+        }
+    }
+
+    // ! Epilogue that leaves C as the product computed it
+    struct NoEpilogue {
+        template<typename T>
+        void operator()(size_t, size_t, T &) const {}
+    };
+
+    // ! Multiplies an MR x kc micro-panel of A by a kc x NR micro-panel of B and stores the valid mr x nr part
+    // ! of the tile in C, whose first element is (row, col) of the whole matrix. When beta is zero, C is only
+    // ! written to, never read
+    template<typename T, typename Epilogue>
+    static void microKernel(size_t kc, const T *a, const T *b, T *c, size_t rsc,
+        size_t mr, size_t nr, T alpha, T beta, size_t row, size_t col, const Epilogue &epilogue) {
+        T ab[MR * NR] = {};
+
+        for(size_t p = 0; p < kc; p++, a += MR, b += NR)
+            for(size_t i = 0; i < MR; i++)
+                for(size_t j = 0; j < NR; j++)
+                    ab[i * NR + j] += a[i] * b[j];
+
+        for(size_t i = 0; i < mr; i++) {
+            for(size_t j = 0; j < nr; j++) {
+                T &cij = c[i * rsc + j];
+                cij = beta == 0 ? alpha * ab[i * NR + j] : beta * cij + alpha * ab[i * NR + j];
+                epilogue(row + i, col + j, cij);
+            }
+        }
+    }
+
+    // ! Multiplies a packed mc x kc block of A by columns [j0, j1) of a packed kc x nc block of B
+    template<typename T, typename Epilogue>
+    static void macroKernel(size_t mc, size_t j0, size_t j1, size_t kc, const T *aPacked, const T *bPacked,
+        T *c, size_t rsc, T alpha, T beta, size_t row, size_t col, const Epilogue &epilogue) {
+        for(size_t jr = j0; jr < j1; jr += NR) {
+            size_t nr = min<size_t>(NR, j1 - jr);
+
+            for(size_t ir = 0; ir < mc; ir += MR) {
+                size_t mr = min<size_t>(MR, mc - ir);
+                microKernel(kc, aPacked + ir * kc, bPacked + jr * kc, c + ir * rsc + jr, rsc, mr, nr, alpha, beta,
+                            row + ir, col + jr, epilogue);
+            }
+        }
+    }
+
+    // ! Packing buffer of the calling thread, one for panels of A and one for panels of B. Buffers outlive the
+    // ! call, so repeated products of the same shape, as in training loops, allocate nothing after the first
+    template<typename T>
+    static T *packingBuffer(bool forB, size_t size) {
+        static thread_local Workspace<T> buffers[2];
+        Workspace<T> &buffer = buffers[forB];
+
+        buffer.reserve(Workspace<T>::footprint(size));
+        return buffer.take(size);
+    }
+
+public:
+
+    // ! Computes C = alpha * A * B + beta * C, where A is m x k, B is k x n and C is m x n.
+    // ! Element (i, j) of A is read from a[i * rsa + j * csa] (and likewise for B), so a transposed operand is
+    // ! passed by swapping its strides. C is row-major with row stride rsc
+    // ! \param m number of rows of A and C
+    // ! \param n number of columns of B and C
+    // ! \param k number of columns of A and rows of B
+    // ! \param alpha scalar multiplying A * B
+    // ! \param a pointer to the first element of A
+    // ! \param rsa row stride of A
+    // ! \param csa column stride of A
+    // ! \param b pointer to the first element of B
+    // ! \param rsb row stride of B
+    // ! \param csb column stride of B
+    // ! \param beta scalar multiplying C. If 0, the previous contents of C are ignored
+    // ! \param c pointer to the first element of C
+    // ! \param rsc row stride of C
+    template<typename T>
+    static void gemm(size_t m, size_t n, size_t k, T alpha,
+        const T *a, size_t rsa, size_t csa,
+        const T *b, size_t rsb, size_t csb,
+        T beta, T *c, size_t rsc) {
+        gemm(m, n, k, alpha, a, rsa, csa, b, rsb, csb, beta, c, rsc, NoEpilogue());
+    }
+
+    // ! Computes C = alpha * A * B + beta * C like the other overload, then calls epilogue(i, j, C(i, j)) on every
+    // ! element of C as soon as its final value is stored, while its tile is still in cache. The epilogue may
+    // ! modify the element, which fuses element-wise operations such as adding a bias or applying an activation
+    // ! function into the product, instead of passing over C again. It is called from several threads at once,
+    // ! exactly once for each element
+    template<typename T, typename Epilogue>
+    static void gemm(size_t m, size_t n, size_t k, T alpha,
+        const T *a, size_t rsa, size_t csa,
+        const T *b, size_t rsb, size_t csb,
+        T beta, T *c, size_t rsc, const Epilogue &epilogue) {
+        if(m == 0 or n == 0)
+            return;
+
+        if(k == 0) {
+            for(size_t i = 0; i < m; i++)
+                for(size_t j = 0; j < n; j++) {
+                    c[i * rsc + j] = beta == 0 ? 0 : beta * c[i * rsc + j];
+                    epilogue(i, j, c[i * rsc + j]);
+                }
+
+            return;
+        }
+
+        size_t ncMax = min<size_t>(NC, n);
+        T *bPacked = packingBuffer<T>(true, min<size_t>(KC, k) * ((ncMax + NR - 1) / NR) * NR);
+
+        for(size_t jc = 0; jc < n; jc += NC) {
+            size_t nc = min<size_t>(NC, n - jc);
+
+            for(size_t pc = 0; pc < k; pc += KC) {
+                size_t kc = min<size_t>(KC, k - pc);
+                // partial products after the first panel are accumulated on top of C
+                T betaPanel = pc == 0 ? beta : T(1);
+                bool parallel = m * nc * kc >= 32768;
+
+                const T *bBlock = b + pc * rsb + jc * csb;
+
+                #pragma omp parallel for if(parallel)
+                for(size_t jr = 0; jr < nc; jr += NR)
+                    packB(kc, nc, jr, bBlock, rsb, csb, bPacked);
+
+                size_t mBlocks = (m + MC - 1) / MC, nBlocks = (nc + NB - 1) / NB;
+
+                #pragma omp parallel if(parallel)
+                {
+                    T *aPacked = packingBuffer<T>(false, MC * KC);
+                    size_t packedBlock = mBlocks;
+
+                    // static scheduling hands each thread a contiguous run of tiles, so the block of A it
+                    // packed last is reused for all the column blocks that follow it
+                    #pragma omp for collapse(2) schedule(static)
+                    for(size_t ib = 0; ib < mBlocks; ib++) {
+                        for(size_t jb = 0; jb < nBlocks; jb++) {
+                            size_t ic = ib * MC, mc = min<size_t>(MC, m - ic);
+
+                            if(packedBlock != ib) {
+                                packA(mc, kc, a + ic * rsa + pc * csa, rsa, csa, aPacked);
+                                packedBlock = ib;
+                            }
+
+                            size_t j0 = jb * NB, j1 = min<size_t>(nc, (jb + 1) * NB);
+
+                            // the epilogue runs on the last panel, once the elements are final
+                            if(pc + kc == k)
+                                macroKernel(mc, j0, j1, kc, aPacked, bPacked, c + ic * rsc + jc, rsc, alpha,
+                                    betaPanel, ic, jc, epilogue);
+                            else
+                                macroKernel(mc, j0, j1, kc, aPacked, bPacked, c + ic * rsc + jc, rsc, alpha,
+                                    betaPanel, ic, jc, NoEpilogue());
+                        }
+                    }
+                }
+            }
+        }
+    }
+
+    // ! Gives direct access to the elements of a matrix. Matrix keeps its elements in a single row-major
+    // ! vector, so the address of the first element reaches all of them
+    // ! \param m a matrix
+    // ! \return pointer to the first element of <code>m</code>, or a null pointer if it is empty
+    template<typename T>
+    static const T *data(const Matrix<T> &m) {
+        return m.nRows() * m.nCols() == 0 ? nullptr : &const_cast<Matrix<T> &>(m)(0, 0);
+    }
+
+    // ! \param m a matrix
+    // ! \return pointer to the first element of <code>m</code>, or a null pointer if it is empty
+    template<typename T>
+    static T *data(Matrix<T> &m) {
+        return m.nRows() * m.nCols() == 0 ? nullptr : &m(0, 0);
+    }
+
+    // ! Multiplication of two matrix views. Transposed views and blocks are read in place
+    // ! \param a left operand
+    // ! \param b right operand
+    // ! \return a * b
+    template<typename T>
+    static Matrix<T> multiply(const MatrixView<T> &a, const MatrixView<T> &b) {
+        if(a.nCols() != b.nRows())
+            throw invalid_argument(
+                "Cannot multiply these matrices: L = " + to_string(a.nRows()) + "x" + to_string(a.nCols())
+                + ", R = " + to_string(b.nRows()) + "x" + to_string(b.nCols()));
+
+        Matrix<T> result(a.nRows(), b.nCols());
+
+        gemm<T>(a.nRows(), b.nCols(), a.nCols(), 1,
+            a.data(), a.rowStride(), a.colStride(),
+            b.data(), b.rowStride(), b.colStride(),
+            0, data(result), b.nCols());
+
+        return result;
+    }
+
+    // ! Multiplies a matrix by another after subtracting a vector from every row of the first, (A - 1 shift') B.
+    // ! Rows are shifted a tile at a time into a buffer of each thread, so the shifted copy of A is never formed
+    // ! whole, yet nothing is lost to the cancellation of computing AB - 1 (shift' B) when A has a large mean
+    // ! \param a left operand
+    // ! \param shift vector with one element per column of <code>a</code>
+    // ! \param b right operand
+    // ! \return (a - 1 shift') * b
+    template<typename T>
+    static Matrix<T> multiplyShifted(const MatrixView<T> &a, const T *shift, const MatrixView<T> &b) {
+        if(a.nCols() != b.nRows())
+            throw invalid_argument(
+                "Cannot multiply these matrices: L = " + to_string(a.nRows()) + "x" + to_string(a.nCols())
+                + ", R = " + to_string(b.nRows()) + "x" + to_string(b.nCols()));
+
+        size_t m = a.nRows(), k = a.nCols(), n = b.nCols();
+        Matrix<T> result(m, n);
+        T *c = data(result);
+
+        // with a single tile, the product is parallelized by gemm() instead
+        #pragma omp parallel if(m > ROW_TILE and m * k > 65536)
+        {
+            vector<T> tile(std::min<size_t>(m, ROW_TILE) * k);
+
+            #pragma omp for schedule(static)
+            for(size_t i0 = 0; i0 < m; i0 += ROW_TILE) {
+                size_t rows = std::min<size_t>(ROW_TILE, m - i0);
+
+                for(size_t i = 0; i < rows; i++)
+                    for(size_t j = 0; j < k; j++)
+                        tile[i * k + j] = a(i0 + i, j) - shift[j];
+
+                gemm<T>(rows, n, k, 1, tile.data(), k, 1, b.data(), b.rowStride(), b.colStride(), 0, c + i0 * n, n);
+            }
+        }
+
+        return result;
+    }
+
+    // ! Matrix multiplication, optionally transposing either operand without copying it
+    // ! \param a left operand
+    // ! \param transA whether to multiply by the transpose of <code>a</code>
+    // ! \param b right operand
+    // ! \param transB whether to multiply by the transpose of <code>b</code>
+    // ! \return op(a) * op(b), where op transposes its argument or leaves it as it is
+    template<typename T>
+    static Matrix<T> multiply(const Matrix<T> &a, bool transA, const Matrix<T> &b, bool transB) {
+        MatrixView<T> aView(a), bView(b);
+        return multiply(transA ? aView.transpose() : aView, transB ? bView.transpose() : bView);
+    }
+
+    // ! Matrix multiplication
+    // ! \param a left operand
+    // ! \param b right operand
+    // ! \return a * b
+    template<typename T>
+    static Matrix<T> multiply(const Matrix<T> &a, const Matrix<T> &b) {
+        return multiply(MatrixView<T>(a), MatrixView<T>(b));
+    }
+};
+
+
+#endif // MACHINE_LEARNING_GEMM_HPP
@@ -0,0 +1,179 @@
+/**
+ * @author Douglas De Rizzo Meneghetti (douglasrizzom@gmail.com)
+ * @brief  Principal component analysis over data sets read in batches
+ * @date   2026-10-16
+ */
+
+#ifndef MACHINE_LEARNING_INCREMENTALPCA_HPP
+#define MACHINE_LEARNING_INCREMENTALPCA_HPP
+
+#include <vector>
+#include <stdexcept>
+#include "../include/matrix/Matrix.hpp"
+#include "MatrixView.hpp"
+#include "Gemm.hpp"
+#include "SymmetricEigen.hpp"
+#include "BatchReader.hpp"
+
+using namespace std;
+
+
+/**
+ * Principal component analysis that never keeps the data set in memory.
+ *
+ * Each batch passed to partialFit() is reduced to its mean and scatter matrix, which are merged into running
+ * totals with the pairwise update of Chan, Golub and LeVeque. This is as accurate as centering the whole data set at
+ * once. Only the d-element mean and the d x d scatter matrix are kept, so memory does not depend on the number of
+ * elements. Components are computed from the covariance matrix the first time they are needed after a batch.
+ */
+class IncrementalPCA {
+private:
+    size_t nFeatures;
+    unsigned long long nElements;
+    // running mean (d x 1) and sum of squared deviations from it (d x d)
+    MatrixD means, scatter;
+    MatrixD eigenvalues, eigenvectors, percentages, cumPercentages;
+    bool stale;
+
+    // ! Diagonalizes the covariance matrix accumulated so far, if batches were added since the last time
+    void updateComponents() {
+        if(!stale)
+            return;
+
+        if(nElements < 2)
+            throw runtime_error("At least two elements are needed to compute principal components");
+
+        MatrixD covariances = scatter / static_cast<double>(nElements - 1);
+        SymmetricEigen eig(covariances);
+        eigenvalues = eig.getEigenvalues();
+        eigenvectors = eig.getEigenvectors();
+
+        double sumVar = 0;
+
+        for(size_t i = 0; i < nFeatures; i++)
+            sumVar += covariances(i, i);
+
+        percentages = MatrixD(nFeatures, 1);
+        cumPercentages = MatrixD(nFeatures, 1);
+
+        for(size_t i = 0; i < nFeatures; i++) {
+            percentages(i, 0) = eigenvalues(i, 0) / sumVar;
+            cumPercentages(i, 0) = i == 0 ? percentages(i, 0) : percentages(i, 0) + cumPercentages(i - 1, 0);
+        }
+
+        stale = false;
+    }
+
+public:
+
+    IncrementalPCA() : nFeatures(0), nElements(0), stale(false) {}
+
+    /**
+     * Adds a batch of elements to the model. Batches can have any number of rows, but always the same columns
+     * @param batch a Matrix, or a view of one, containing elements in rows and features in columns
+     */
+    void partialFit(MatrixViewD batch) {
+        if(batch.isEmpty())
+            return;
+
+        if(nElements == 0) {
+            nFeatures = batch.nCols();
+            means = MatrixD::zeros(nFeatures, 1);
+            scatter = MatrixD::zeros(nFeatures, nFeatures);
+        } else if(batch.nCols() != nFeatures)
+            throw invalid_argument("Batch has " + to_string(batch.nCols()) + " features, but the model was fit on "
+                                   + to_string(nFeatures));
+
+        size_t m = batch.nRows();
+        MatrixD batchMeans = batch.mean();
+        MatrixD centered = batch.minusMean();
+        MatrixD batchScatter = Gemm::multiply(centered, true, centered, false);
+
+        // merge the statistics of the batch into the running ones
+        double n = static_cast<double>(nElements), total = n + m, weight = n * m / total;
+        vector<double> delta(nFeatures);
+
+        for(size_t j = 0; j < nFeatures; j++)
+            delta[j] = batchMeans(j, 0) - means(j, 0);
+
+        double *s = Gemm::data(scatter);
+        const double *bs = Gemm::data(batchScatter);
+
+        #pragma omp parallel for if(nFeatures * nFeatures > 65536)
+        for(size_t i = 0; i < nFeatures; i++)
+            for(size_t j = 0; j < nFeatures; j++)
+                s[i * nFeatures + j] += bs[i * nFeatures + j] + weight * delta[i] * delta[j];
+
+        for(size_t j = 0; j < nFeatures; j++)
+            means(j, 0) += delta[j] * m / total;
+
+        nElements += m;
+        stale = true;
+    }
+
+    /**
+     * Fits the model to a data set read in batches, such as a file larger than the available memory
+     * @param source a CSVBatchReader, a MatrixBatchReader or any object with the same next() method
+     * @param batchSize number of elements read at a time
+     */
+    template<typename Source>
+    void fitStream(Source &source, size_t batchSize = 1024) {
+        MatrixD batch;
+
+        while(source.next(batchSize, batch))
+            partialFit(batch);
+    }
+
+    /**
+     * Projects elements onto the principal components with the largest eigenvalues. Elements are centered with the
+     * mean of all elements seen by the model
+     * @param data a Matrix, or a view of one, containing elements in rows and features in columns
+     * @param numComponents number of components to project onto. 0 uses all of them
+     * @return n x numComponents matrix with the projected elements
+     */
+    MatrixD transform(MatrixViewD data, size_t numComponents = 0) {
+        updateComponents();
+
+        if(data.nCols() != nFeatures)
+            throw invalid_argument("Data has " + to_string(data.nCols()) + " features, but the model was fit on "
+                                   + to_string(nFeatures));
+
+        if(numComponents == 0 or numComponents > nFeatures)
+            numComponents = nFeatures;
+
+        // rows are centered a tile at a time as they are multiplied, which does not copy the whole data set
+        return Gemm::multiplyShifted(data, Gemm::data(means), MatrixViewD(eigenvectors).cols(0, numComponents));
+    }
+
+    const MatrixD &getEigenvalues() {
+        updateComponents();
+        return eigenvalues;
+    }
+
+    const MatrixD &getEigenvectors() {
+        updateComponents();
+        return eigenvectors;
+    }
+
+    const MatrixD &getPercentages() {
+        updateComponents();
+        return percentages;
+    }
+
+    const MatrixD &getCumPercentages() {
+        updateComponents();
+        return cumPercentages;
+    }
+
+    // ! \return column vector with the mean of each feature over all elements seen so far
+    const MatrixD &getMeans() const {
+        return means;
+    }
+
+    unsigned long long getNElements() const {
+        return nElements;
+    }
+};
+
+
+#endif // MACHINE_LEARNING_INCREMENTALPCA_HPP
@@ -8,8 +8,12 @@
 #define MACHINE_LEARNING_KMEANS_HPP
 
 #include "../include/matrix/Matrix.hpp"
+#include "MatrixView.hpp"
 #include "Metrics.hpp"
-#include "../include/mersenne_twister/MersenneTwister.hpp"
+#include "Gemm.hpp"
+#include <random>
+#include <chrono>
+#include <cstdint>
 
 
 /**
@@ -17,47 +21,591 @@
  */
 class KMeans {
 public:
-    enum InitializationMethod { RANDOM, SAMPLE };
+    // ! How the initial centroids are chosen. RANDOM draws them uniformly within the bounds of each feature and
+    // ! SAMPLE picks k distinct elements. KMEANSPP (k-means++) picks elements one at a time, each with probability
+    // ! proportional to its squared distance to the closest centroid already picked, which spreads centroids
+    // ! across the clusters. KMEANS_PARALLEL (k-means||) oversamples candidates in a few passes over the data and
+    // ! reduces them to k centroids by clustering the candidates, weighted by the number of elements they represent
+    enum InitializationMethod { RANDOM, SAMPLE, KMEANSPP, KMEANS_PARALLEL };
+    // ! How elements are assigned to their closest centroids. LLOYD computes all element-centroid distances in
+    // ! every iteration. HAMERLY and ELKAN keep bounds on those distances and use the triangle inequality to skip
+    // ! the ones that cannot change an assignment, producing the same clusters as LLOYD. HAMERLY keeps one lower
+    // ! bound per element and suits a small number of clusters; ELKAN keeps one per element and centroid and prunes
+    // ! more when there are many. ACCELERATED chooses between them according to k
+    enum AssignmentMethod { LLOYD, HAMERLY, ELKAN, ACCELERATED };
 private:
+    // largest number of clusters for which ACCELERATED chooses Hamerly's algorithm; number of sampling rounds and
+    // oversampling factor, in multiples of k, of k-means||; iterations used to recluster its weighted candidates;
+    // number of rows whose squared errors are summed together
+    enum { HAMERLY_MAX_K = 32, PARALLEL_ROUNDS = 5, OVERSAMPLING = 2, RECLUSTER_ITERATIONS = 10, SSE_CHUNK = 4096 };
+
+    // ! State of one run of the algorithm, from its initial centroids to convergence
+    struct Solution {
+        MatrixD centroids;
+        // cluster of each element
+        vector<uint32_t> labels;
+        double sse;
+        unsigned int iterations;
+        unsigned long long distanceComputations;
+
+        Solution() : sse(0), iterations(0), distanceComputations(0) {}
+    };
+
     MatrixD X, y, centroids;
     unsigned int k, totalIterations;
     double distance, sse;
     InitializationMethod initMethod;
+    AssignmentMethod assignmentMethod;
+    unsigned long long distanceComputations;
+    // seed of the random number generators of all restarts
+    unsigned long long seed;
+
+    // ! Distance between two points, in the norm used by the algorithm
+    double pointDistance(const double *a, const double *b, size_t d) const {
+        double dist = 0;
+
+        if(distance == 2) {
+            for(size_t j = 0; j < d; j++)
+                dist += (a[j] - b[j]) * (a[j] - b[j]);
+
+            return sqrt(dist);
+        }
+
+        if(isinf(distance)) {
+            for(size_t j = 0; j < d; j++)
+                dist = max(dist, abs(a[j] - b[j]));
+
+            return dist;
+        }
+
+        for(size_t j = 0; j < d; j++)
+            dist += pow(abs(a[j] - b[j]), distance);
+
+        return pow(dist, 1 / distance);
+    }
+
+    // ! Moves each centroid to the mean of its elements. Centroids without elements stay where they are
+    // ! \param labels cluster of each element
+    // ! \param centroids centroids to be moved
+    // ! \param drift receives the distance each centroid moved
+    void moveCentroids(const vector<uint32_t> &labels, MatrixD &centroids, vector<double> &drift) const {
+        size_t d = X.nCols();
+        vector<size_t> counts;
+        MatrixD sums = MatrixViewD(X).groupSums(labels, k, counts);
+        double *s = Gemm::data(sums), *c = Gemm::data(centroids);
+
+        for(size_t c1 = 0; c1 < k; c1++) {
+            if(counts[c1] == 0) {
+                drift[c1] = 0;
+                continue;
+            }
+
+            for(size_t j = 0; j < d; j++)
+                s[c1 * d + j] /= counts[c1];
+
+            drift[c1] = pointDistance(s + c1 * d, c + c1 * d, d);
+            copy(s + c1 * d, s + (c1 + 1) * d, c + c1 * d);
+        }
+    }
+
+    // ! Half the distance from each centroid to the closest other centroid. An element closer to its centroid than
+    // ! that cannot be closer to any other centroid
+    // ! \param solution solution whose centroids are compared
+    // ! \param centroidDistances if not null, receives the k x k matrix of distances between centroids
+    vector<double> halfSeparations(Solution &solution, vector<double> *centroidDistances) const {
+        const MatrixD &centroids = solution.centroids;
+        size_t d = X.nCols();
+        const double *c = Gemm::data(centroids);
+        vector<double> separation(k, numeric_limits<double>::infinity());
+
+        if(centroidDistances != nullptr)
+            centroidDistances->assign(k * k, 0);
+
+        for(size_t c1 = 0; c1 < k; c1++)
+            for(size_t c2 = c1 + 1; c2 < k; c2++) {
+                double dist = pointDistance(c + c1 * d, c + c2 * d, d);
+                separation[c1] = min(separation[c1], dist / 2);
+                separation[c2] = min(separation[c2], dist / 2);
+
+                if(centroidDistances != nullptr)
+                    (*centroidDistances)[c1 * k + c2] = (*centroidDistances)[c2 * k + c1] = dist;
+            }
+
+        solution.distanceComputations += k * (k - 1) / 2;
+        return separation;
+    }
+
+    // ! Hamerly's algorithm, which keeps, for each element, an upper bound on the distance to its centroid and a
+    // ! lower bound on the distance to every other centroid
+    // ! \param solution solution with the initial centroids, which receives the clusters
+    // ! \param iters maximum number of assignment steps
+    void hamerly(Solution &solution, unsigned int iters) const {
+        size_t n = X.nRows(), d = X.nCols();
+        const double *x = Gemm::data(X);
+        MatrixD &centroids = solution.centroids;
+        vector<uint32_t> &labels = solution.labels;
+        labels.assign(n, 0);
+        vector<double> upper(n), lower(n), drift(k);
+        unsigned long long computations = 0;
+        bool changed = true;
+
+        for(unsigned int iteration = 0; iteration < iters and changed; iteration++) {
+            if(iteration > 0) {
+                moveCentroids(labels, centroids, drift);
+
+                // the lower bound of an element decreases by the largest drift among the other centroids
+                size_t farthest = static_cast<size_t>(max_element(drift.begin(), drift.end()) - drift.begin());
+                double secondDrift = 0;
+
+                for(size_t c1 = 0; c1 < k; c1++)
+                    if(c1 != farthest)
+                        secondDrift = max(secondDrift, drift[c1]);
+
+                for(size_t i = 0; i < n; i++) {
+                    upper[i] += drift[labels[i]];
+                    lower[i] -= labels[i] == farthest ? secondDrift : drift[farthest];
+                }
+            }
+
+            vector<double> separation = halfSeparations(solution, nullptr);
+            const double *c = Gemm::data(centroids);
+            changed = false;
+
+            #pragma omp parallel for reduction(+:computations) reduction(||:changed) schedule(static)
+            for(size_t i = 0; i < n; i++) {
+                const double *xi = x + i * d;
+
+                if(iteration > 0) {
+                    double bound = max(separation[labels[i]], lower[i]);
+
+                    if(upper[i] <= bound)
+                        continue;
+
+                    // tighten the upper bound and test again before looking at every centroid
+                    upper[i] = pointDistance(xi, c + labels[i] * d, d);
+                    computations++;
+
+                    if(upper[i] <= bound)
+                        continue;
+                }
+
+                size_t best = 0;
+                double bestDistance = numeric_limits<double>::infinity(),
+                       secondDistance = numeric_limits<double>::infinity();
+
+                for(size_t c1 = 0; c1 < k; c1++) {
+                    double dist = pointDistance(xi, c + c1 * d, d);
+
+                    if(dist < bestDistance) {
+                        secondDistance = bestDistance;
+                        bestDistance = dist;
+                        best = c1;
+                    } else if(dist < secondDistance)
+                        secondDistance = dist;
+                }
+
+                computations += k;
+
+                if(iteration == 0 or best != labels[i])
+                    changed = true;
+
+                labels[i] = best;
+                upper[i] = bestDistance;
+                lower[i] = secondDistance;
+            }
+
+            solution.iterations++;
+        }
+
+        // when the iteration limit is reached, centroids are still moved to the means of the last assignment
+        if(changed)
+            moveCentroids(labels, centroids, drift);
+
+        solution.distanceComputations += computations;
+    }
+
+    // ! Elkan's algorithm, which keeps, for each element, an upper bound on the distance to its centroid and one
+    // ! lower bound on the distance to each centroid
+    // ! \param solution solution with the initial centroids, which receives the clusters
+    // ! \param iters maximum number of assignment steps
+    void elkan(Solution &solution, unsigned int iters) const {
+        size_t n = X.nRows(), d = X.nCols();
+        const double *x = Gemm::data(X);
+        MatrixD &centroids = solution.centroids;
+        vector<uint32_t> &labels = solution.labels;
+        labels.assign(n, 0);
+        vector<double> upper(n), lower(n * k), drift(k), centroidDistances;
+        // whether the upper bound of each element is the exact distance to its centroid
+        vector<char> tight(n, 0);
+        unsigned long long computations = 0;
+        bool changed = true;
+
+        for(unsigned int iteration = 0; iteration < iters and changed; iteration++) {
+            if(iteration > 0) {
+                moveCentroids(labels, centroids, drift);
+
+                for(size_t i = 0; i < n; i++) {
+                    upper[i] += drift[labels[i]];
+                    // a bound loosened in an earlier iteration stays loose even if its centroid did not move
+                    if(drift[labels[i]] > 0)
+                        tight[i] = 0;
+
+                    for(size_t c1 = 0; c1 < k; c1++)
+                        lower[i * k + c1] = max(0.0, lower[i * k + c1] - drift[c1]);
+                }
+            }
+
+            vector<double> separation = halfSeparations(solution, &centroidDistances);
+            const double *c = Gemm::data(centroids);
+            changed = false;
+
+            #pragma omp parallel for reduction(+:computations) reduction(||:changed) schedule(static)
+            for(size_t i = 0; i < n; i++) {
+                const double *xi = x + i * d;
+                double *li = &lower[i * k];
+
+                if(iteration == 0) {
+                    size_t best = 0;
+
+                    for(size_t c1 = 0; c1 < k; c1++) {
+                        li[c1] = pointDistance(xi, c + c1 * d, d);
+
+                        if(li[c1] < li[best])
+                            best = c1;
+                    }
+
+                    computations += k;
+                    labels[i] = best;
+                    upper[i] = li[best];
+                    tight[i] = 1;
+                    changed = true;
+                    continue;
+                }
+
+                size_t label = labels[i];
+
+                if(upper[i] <= separation[label])
+                    continue;
+
+                for(size_t c1 = 0; c1 < k; c1++) {
+                    // c1 can only be closer if both bounds allow it
+                    if(c1 == label or upper[i] <= li[c1] or upper[i] <= centroidDistances[label * k + c1] / 2)
+                        continue;
+
+                    if(!tight[i]) {
+                        upper[i] = li[label] = pointDistance(xi, c + label * d, d);
+                        tight[i] = 1;
+                        computations++;
+
+                        if(upper[i] <= li[c1] or upper[i] <= centroidDistances[label * k + c1] / 2)
+                            continue;
+                    }
+
+                    li[c1] = pointDistance(xi, c + c1 * d, d);
+                    computations++;
+
+                    if(li[c1] < upper[i]) {
+                        label = c1;
+                        upper[i] = li[c1];
+                    }
+                }
+
+                if(label != labels[i]) {
+                    labels[i] = label;
+                    changed = true;
+                }
+            }
+
+            solution.iterations++;
+        }
+
+        // when the iteration limit is reached, centroids are still moved to the means of the last assignment
+        if(changed)
+            moveCentroids(labels, centroids, drift);
+
+        solution.distanceComputations += computations;
+    }
+
+    // ! Lloyd's algorithm, which computes the distances between all elements and centroids in every iteration
+    // ! \param solution solution with the initial centroids, which receives the clusters
+    // ! \param iters maximum number of assignment steps
+    void lloyd(Solution &solution, unsigned int iters) const {
+        size_t n = X.nRows();
+        vector<uint32_t> &labels = solution.labels;
+        vector<uint32_t> current(n);
+        vector<double> drift(k);
+        labels.clear();
+
+        for(unsigned int currentIteration = 0; currentIteration < iters; currentIteration++) {
+            // assignment
+            MatrixI closest = Metrics::nearest(X, solution.centroids, 1, distance, false).first;
+
+            for(size_t i = 0; i < n; i++)
+                current[i] = static_cast<uint32_t>(closest(i, 0));
+
+            solution.distanceComputations += n * k;
+            solution.iterations++;
+
+            if(current == labels)
+                break;
+
+            labels.swap(current);
+            current.resize(n);
+            moveCentroids(labels, solution.centroids, drift); // centroid update
+        }
+    }
+
+    // ! Squared distance from every point to the closest of a set of centers, updated as centers are added
+    // ! \param points row-major points with as many features as X
+    // ! \param n number of points
+    // ! \param center the center being added
+    // ! \param centerIndex index of the new center, stored for the points it becomes the closest center of
+    // ! \param minDistances squared distance from each point to its closest center
+    // ! \param closest if not null, index of the closest center of each point
+    void addCenter(const double *points, size_t n, const double *center, size_t centerIndex,
+        vector<double> &minDistances, vector<size_t> *closest) const {
+        size_t d = X.nCols();
+
+        #pragma omp parallel for if(n * d > 65536)
+        for(size_t i = 0; i < n; i++) {
+            double dist = pointDistance(points + i * d, center, d);
+
+            if(dist * dist < minDistances[i]) {
+                minDistances[i] = dist * dist;
+
+                if(closest != nullptr)
+                    (*closest)[i] = centerIndex;
+            }
+        }
+    }
+
+    // ! D² sampling of k-means++: picks points one at a time, each with probability proportional to its weight
+    // ! times its squared distance to the closest point already picked
+    // ! \param generator random number generator
+    // ! \param points row-major points with as many features as X
+    // ! \param n number of points
+    // ! \param weights weight of each point, or null for unit weights
+    // ! \return indices of k points
+    vector<size_t> seedPlusPlus(mt19937_64 &generator, const double *points, size_t n,
+        const vector<double> *weights) const {
+        size_t d = X.nCols();
+        vector<double> minDistances(n, numeric_limits<double>::infinity());
+        vector<size_t> chosen;
+
+        for(size_t c = 0; c < k; c++) {
+            // the first point is drawn by weight alone, the others also by their squared distances
+            double total = 0;
+
+            for(size_t i = 0; i < n; i++)
+                total += (weights == nullptr ? 1 : (*weights)[i]) * (c == 0 ? 1 : minDistances[i]);
+
+            size_t pick = n - 1;
+
+            if(total > 0) {
+                double target = uniform_real_distribution<double>(0, total)(generator), cumulative = 0;
+
+                for(size_t i = 0; i < n; i++) {
+                    cumulative += (weights == nullptr ? 1 : (*weights)[i]) * (c == 0 ? 1 : minDistances[i]);
+
+                    if(cumulative > target) {
+                        pick = i;
+                        break;
+                    }
+                }
+            } else
+                // every point coincides with a center already picked
+                pick = uniform_int_distribution<size_t>(0, n - 1)(generator);
+
+            chosen.push_back(pick);
+            addCenter(points, n, points + pick * d, c, minDistances, nullptr);
+        }
+
+        return chosen;
+    }
+
+    // ! k-means|| initialization (Bahmani et al., 2012). Each round samples every element independently, with
+    // ! probability proportional to its squared distance to the current candidates, adding about OVERSAMPLING * k
+    // ! candidates per round. Candidates are weighted by the number of elements closest to them and reduced to k
+    // ! centroids by weighted k-means++ followed by a few weighted Lloyd iterations
+    MatrixD seedParallel(mt19937_64 &generator) const {
+        size_t n = X.nRows(), d = X.nCols();
+        const double *x = Gemm::data(X);
+        vector<size_t> candidates(1, uniform_int_distribution<size_t>(0, n - 1)(generator)), closest(n, 0);
+        vector<double> minDistances(n, numeric_limits<double>::infinity()), draws(n);
+        addCenter(x, n, x + candidates[0] * d, 0, minDistances, &closest);
+
+        for(unsigned int round = 0; round < PARALLEL_ROUNDS; round++) {
+            double cost = 0;
+
+            for(size_t i = 0; i < n; i++)
+                cost += minDistances[i];
+
+            if(cost == 0)
+                break;
+
+            // random numbers are drawn in order, so the candidates do not depend on the number of threads
+            for(size_t i = 0; i < n; i++)
+                draws[i] = uniform_real_distribution<double>(0, 1)(generator);
+
+            size_t previous = candidates.size();
+
+            for(size_t i = 0; i < n; i++)
+                if(draws[i] * cost < OVERSAMPLING * k * minDistances[i])
+                    candidates.push_back(i);
+
+            for(size_t c = previous; c < candidates.size(); c++)
+                addCenter(x, n, x + candidates[c] * d, c, minDistances, &closest);
+        }
+
+        // too few candidates to choose from, which only happens with very few distinct elements
+        if(candidates.size() <= k) {
+            vector<size_t> chosen = seedPlusPlus(generator, x, n, nullptr);
+            candidates.assign(chosen.begin(), chosen.end());
+
+            // the closest candidate of each element must index the new candidates, so it is found again
+            minDistances.assign(n, numeric_limits<double>::infinity());
+
+            for(size_t c = 0; c < candidates.size(); c++)
+                addCenter(x, n, x + candidates[c] * d, c, minDistances, &closest);
+        }
+
+        size_t m = candidates.size();
+        vector<double> points(m * d), weights(m, 0);
+
+        for(size_t c = 0; c < m; c++)
+            copy(x + candidates[c] * d, x + (candidates[c] + 1) * d, points.begin() + c * d);
+
+        for(size_t i = 0; i < n; i++)
+            weights[closest[i]]++;
+
+        vector<size_t> chosen = seedPlusPlus(generator, points.data(), m, &weights);
+        vector<double> centers(k * d);
+
+        for(size_t c = 0; c < k; c++)
+            copy(points.begin() + chosen[c] * d, points.begin() + (chosen[c] + 1) * d, centers.begin() + c * d);
+
+        // weighted Lloyd iterations over the candidates
+        vector<size_t> labels(m);
+
+        for(unsigned int iteration = 0; iteration < RECLUSTER_ITERATIONS; iteration++) {
+            for(size_t i = 0; i < m; i++) {
+                double best = numeric_limits<double>::infinity();
+
+                for(size_t c = 0; c < k; c++) {
+                    double dist = pointDistance(&points[i * d], &centers[c * d], d);
+
+                    if(dist < best) {
+                        best = dist;
+                        labels[i] = c;
+                    }
+                }
+            }
+
+            vector<double> sums(k * d, 0), totals(k, 0);
+
+            for(size_t i = 0; i < m; i++) {
+                totals[labels[i]] += weights[i];
+
+                for(size_t j = 0; j < d; j++)
+                    sums[labels[i] * d + j] += weights[i] * points[i * d + j];
+            }
+
+            for(size_t c = 0; c < k; c++)
+                if(totals[c] > 0)
+                    for(size_t j = 0; j < d; j++)
+                        centers[c * d + j] = sums[c * d + j] / totals[c];
+        }
+
+        return MatrixD(k, d, centers);
+    }
+
+    // ! Draws the initial centroids of a restart
+    // ! \param generator random number generator of the restart
+    // ! \param colMin smallest value of each feature
+    // ! \param colMax largest value of each feature
+    MatrixD initialCentroids(mt19937_64 &generator, const vector<double> &colMin, const vector<double> &colMax) const {
+        size_t n = X.nRows(), d = X.nCols();
+        MatrixD result(k, d);
+
+        if(initMethod == RANDOM) {
+            for(size_t i = 0; i < k; i++)
+                for(size_t j = 0; j < d; j++)
+                    result(i, j) = uniform_real_distribution<double>(colMin[j], colMax[j])(generator);
+        } else if(initMethod == SAMPLE) {
+            // k distinct elements, drawn with a partial Fisher-Yates shuffle of their indices
+            vector<size_t> indices(n);
+
+            for(size_t i = 0; i < n; i++)
+                indices[i] = i;
+
+            for(size_t i = 0; i < k; i++) {
+                swap(indices[i], indices[uniform_int_distribution<size_t>(i, n - 1)(generator)]);
+
+                for(size_t j = 0; j < d; j++)
+                    result(i, j) = X(indices[i], j);
+            }
+        } else if(initMethod == KMEANSPP) {
+            vector<size_t> chosen = seedPlusPlus(generator, Gemm::data(X), n, nullptr);
+
+            for(size_t i = 0; i < k; i++)
+                for(size_t j = 0; j < d; j++)
+                    result(i, j) = X(chosen[i], j);
+        } else
+            result = seedParallel(generator);
+
+        return result;
+    }
 
     /**
      * @return Sum of squared errors between elements and their centroids
      */
-    double SSE() {
-        return Metrics::euclidean(X, centroids, false).sum();
+    double SSE(const Solution &solution) const {
+        size_t n = X.nRows(), d = X.nCols();
+        const double *x = Gemm::data(X), *c = Gemm::data(solution.centroids);
+        // chunks of rows are summed in parallel and their totals added in order, so that the result does not
+        // depend on the number of threads
+        size_t nChunks = (n + SSE_CHUNK - 1) / SSE_CHUNK;
+        vector<double> chunkTotals(nChunks, 0);
+
+        #pragma omp parallel for if(n * d > 65536)
+        for(size_t chunk = 0; chunk < nChunks; chunk++)
+            for(size_t i = chunk * SSE_CHUNK; i < min<size_t>(n, (chunk + 1) * SSE_CHUNK); i++) {
+                const double *ci = c + solution.labels[i] * d;
+
+                for(size_t j = 0; j < d; j++)
+                    chunkTotals[chunk] += (x[i * d + j] - ci[j]) * (x[i * d + j] - ci[j]);
+            }
+
+        double total = 0;
+
+        for(double chunkTotal : chunkTotals)
+            total += chunkTotal;
+
+        return total;
     }
 
 public:
 
-    KMeans() {}
+    // ! \param assignmentMethod how elements are assigned to their closest centroids
+    explicit KMeans(AssignmentMethod assignmentMethod = ACCELERATED) :
+        assignmentMethod(assignmentMethod), distanceComputations(0),
+        seed(static_cast<unsigned long long>(chrono::high_resolution_clock::now().time_since_epoch().count())) {}
 
     /**
      * Assigns elements of a data set to clusters
-     * @param data a Matrix containing elements in rows and features in columns
+     * @param data a Matrix, or a view of one, containing elements in rows and features in columns
      * @return column vector with the index of clusters each element is assigned to
      */
-    MatrixD predict(MatrixD data) {
+    MatrixD predict(MatrixViewD data) {
         if(centroids.nCols() != data.nCols())
             throw invalid_argument("Data elements and cluster centroids don't have the same number of dimensions.");
 
-        MatrixD distances = Metrics::minkowski(data, centroids, distance, false);
-        MatrixD results = MatrixD::zeros(data.nRows(), 1);
-
-        for(size_t i = 0; i < distances.nRows(); i++) {
-            for(size_t j = 1; j < distances.nCols(); j++) {
-                double current_c = results(i, 0);
-                double current_d = distances(i, current_c);
-                double new_c = j;
-                double new_d = distances(i, new_c);
+        // the closest centroid is found without storing the distances to all of them
+        MatrixI closest = Metrics::nearest(data, centroids, 1, distance, false).first;
+        MatrixD results(data.nRows(), 1);
 
-                if(new_d < current_d)
-                    results(i, 0) = new_c;
-            }
-        }
+        for(size_t i = 0; i < data.nRows(); i++)
+            results(i, 0) = closest(i, 0);
 
         return results;
     }
@@ -72,61 +620,88 @@ public:
      * @param initMethod centroid initialization method
      * @param verbose whether to output progress or not
      */
-    void fit(MatrixD data,
+    void fit(const MatrixD &data,
         unsigned int k,
         unsigned int iters = 100,
-        unsigned int inits = 100,
+        unsigned int inits = 10,
         double distance = 2,
-        InitializationMethod initMethod = SAMPLE, bool verbose = false) {
-        this->X = data.standardize();
+        InitializationMethod initMethod = KMEANSPP, bool verbose = false) {
+        this->X = MatrixViewD(data).standardize();
         this->k = k;
         this->initMethod = initMethod;
         this->distance = distance;
         this->totalIterations = 0;
-        MersenneTwister twister;
-        double minSSE;
+        this->distanceComputations = 0;
 
-        for(int currentInit = 0; currentInit < inits; currentInit++) {
+        if(k == 0 or k > X.nRows())
+            throw invalid_argument("Number of clusters must be between 1 and the number of elements");
 
-            if(initMethod == RANDOM) {
-                centroids = MatrixD(k, X.nCols());
+        // bounds rely on the triangle inequality, which only holds for p >= 1
+        AssignmentMethod method = distance < 1 ? LLOYD : assignmentMethod;
 
-                for(size_t i = 0; i < centroids.nRows(); i++)
-                    for(size_t j = 0; j < centroids.nCols(); j++)
-                        centroids(i, j) = twister.d_random(X.getColumn(j).min(),
-                            X.getColumn(j).max());
-            } else {
-                vector<int> sample = twister.randomValues(X.nRows(), k, false);
-                centroids = MatrixD();
+        if(method == ACCELERATED)
+            method = k <= HAMERLY_MAX_K ? HAMERLY : ELKAN;
 
-                for(int i = 0; i < sample.size(); i++)
-                    centroids.addRow(X.getRow(sample[i]));
+        // bounds of each feature, used to draw random centroids
+        vector<double> colMin(X.nCols()), colMax(X.nCols());
+
+        if(initMethod == RANDOM) {
+            MatrixViewD XView(X);
+
+            for(size_t j = 0; j < X.nCols(); j++) {
+                colMin[j] = XView.col(j).min();
+                colMax[j] = XView.col(j).max();
             }
+        }
 
-            MatrixD yPrev;
+        Solution best;
+        unsigned int bestInit = inits;
 
-            for(int currentIteration = 0; currentIteration < iters; currentIteration++) {
-                if(verbose)
-                    cout << currentInit << '/' << inits + 1 << '\t'
-                         << currentIteration << '/' << iters + 1 << '\t'
-                         << SSE() << endl;
+        // restarts are independent, so each thread runs whole restarts and the iterations inside them are serial.
+        // Every restart seeds its own generator from the seed and its index, so the result does not depend on the
+        // number of threads or on the order in which restarts finish. A single restart parallelizes its iterations
+        // instead, whose sums are added in an order that does not depend on the number of threads either
+        #pragma omp parallel for schedule(dynamic) if(inits > 1)
+        for(unsigned int currentInit = 0; currentInit < inits; currentInit++) {
+            seed_seq sequence{static_cast<unsigned int>(seed), static_cast<unsigned int>(seed >> 32), currentInit};
+            mt19937_64 generator(sequence);
 
-                MatrixD yCurr = predict(X); // assignment
+            Solution solution;
+            solution.centroids = initialCentroids(generator, colMin, colMax);
 
-                if(yCurr == yPrev)
-                    break;
+            if(method == LLOYD)
+                lloyd(solution, iters);
+            else if(method == HAMERLY)
+                hamerly(solution, iters);
+            else
+                elkan(solution, iters);
 
-                yPrev = yCurr;
-                centroids = X.mean(yCurr); // centroid update
-            }
+            solution.sse = SSE(solution);
+
+            #pragma omp critical
+            {
+                if(verbose)
+                    cout << currentInit + 1 << '/' << inits << '\t' << solution.iterations << " iterations\t"
+                         << solution.sse << endl;
+
+                totalIterations += solution.iterations;
+                distanceComputations += solution.distanceComputations;
 
-            if(currentInit == 0 or SSE() < minSSE) {
-                minSSE = SSE();
-                y = yPrev;
+                // ties go to the earliest restart
+                if(bestInit == inits or solution.sse < best.sse or (solution.sse == best.sse and currentInit < bestInit)) {
+                    best = solution;
+                    bestInit = currentInit;
+                }
             }
         }
 
-        this->sse = minSSE;
+        centroids = best.centroids;
+        y = MatrixD(best.labels.size(), 1);
+
+        for(size_t i = 0; i < best.labels.size(); i++)
+            y(i, 0) = best.labels[i];
+
+        this->sse = best.sse;
     }
 
     const MatrixD &getY() const {
@@ -152,6 +727,29 @@ public:
     double getSse() const {
         return sse;
     }
+
+    AssignmentMethod getAssignmentMethod() const {
+        return assignmentMethod;
+    }
+
+    void setAssignmentMethod(AssignmentMethod assignmentMethod) {
+        KMeans::assignmentMethod = assignmentMethod;
+    }
+
+    unsigned long long getSeed() const {
+        return seed;
+    }
+
+    // ! Sets the seed of the random number generators, making the results of fit() reproducible. By default, the
+    // ! seed is taken from the clock when the object is created
+    void setSeed(unsigned long long seed) {
+        KMeans::seed = seed;
+    }
+
+    // ! \return number of element-centroid and centroid-centroid distances computed by the last call to fit()
+    unsigned long long getDistanceComputations() const {
+        return distanceComputations;
+    }
 };
 
 
@@ -13,6 +13,11 @@
 #include <cmath>
 #include <omp.h>
 #include <chrono>
+#include <memory>
+#include <stdexcept>
+#include "SpatialIndex.hpp"
+#include "AlignedAllocator.hpp"
+#include "PackedHamming.hpp"
 
 using namespace std;
 
@@ -23,57 +28,212 @@ using namespace std;
 class KNN {
 public:
     enum Distance { HAMMING, EUCLIDEAN };
+    // ! Structure used to find the nearest neighbors. AUTOMATIC picks bit-packed rows for categorical data compared
+    // ! by the Hamming distance, a KD-tree for data sets with few features and a ball tree otherwise. HNSW is the
+    // ! only approximate one, trading a little recall for much faster queries on large data sets
+    enum Index { BRUTE_FORCE, KD_TREE, BALL_TREE, AUTOMATIC, HNSW, BIT_PACKED };
 private:
-    vector<vector<double> > data;
-    int yColumn, k;
+    // largest number of features for which AUTOMATIC chooses a KD-tree
+    enum { KD_TREE_MAX_FEATURES = 16 };
+
+    // column of the dependent variable, validated to be non-negative, and number of neighbors
+    size_t yColumn;
+    int k;
 
     Distance distance;
+    Index index;
+
+    // number of data elements and of independent variables in each one
+    size_t nElements, nFeatures;
+    // distance, in elements, between consecutive rows of the feature buffer. Rows are padded with zeros to a
+    // whole number of SIMD registers, which does not change Euclidean or Hamming distances
+    size_t rowStride;
+    // independent variables of the data set, stored contiguously row by row in an aligned buffer.
+    // Both the features and the index that points into them are shared, so copies of the object stay valid
+    shared_ptr<AlignedVector<double> > features;
+    // dependent variable of each data element
+    vector<double> labels;
+    shared_ptr<SpatialIndex> spatialIndex;
+    // parameters of the HNSW graph
+    size_t hnswM, efConstruction, efSearch;
+
+    // number of doubles in a 256-bit SIMD register, to which rows of the feature buffer are padded
+    enum { SIMD_WIDTH = 4 };
+
+    // ! Builds the spatial index over the features, according to the index type and distance function
+    void buildIndex() {
+        SpatialIndex::Metric metric = distance == EUCLIDEAN ? SpatialIndex::EUCLIDEAN : SpatialIndex::HAMMING;
+        Index type = index;
+
+        if(type == BIT_PACKED and distance != HAMMING)
+            throw invalid_argument("Bit-packed rows can only be compared by the Hamming distance");
+
+        // one-hot encoded rows are worth it while they take no more words than the features take doubles. The
+        // words are counted before packing, since rows of continuous features would take words in proportion to n
+        if(type == AUTOMATIC and distance == HAMMING
+           and PackedHammingIndex::countWords(features->data(), nElements, rowStride) <= nFeatures)
+            type = BIT_PACKED;
+
+        if(type == AUTOMATIC)
+            type = nFeatures <= KD_TREE_MAX_FEATURES ? KD_TREE : BALL_TREE;
+
+        if(type == BIT_PACKED)
+            spatialIndex = make_shared<PackedHammingIndex>(features->data(), nElements, rowStride);
+        else if(type == KD_TREE)
+            spatialIndex = make_shared<KDTree>(features->data(), nElements, rowStride, metric);
+        else if(type == BALL_TREE)
+            spatialIndex = make_shared<BallTree>(features->data(), nElements, rowStride, metric);
+        else if(type == HNSW)
+            spatialIndex = make_shared<HNSWGraph>(features->data(), nElements, rowStride, metric,
+                hnswM, efConstruction, efSearch);
+        else
+            spatialIndex.reset();
+    }
+
+    // ! Gives this object its own copy of the features and of the index before they are modified, since they may
+    // ! be shared with copies of the object
+    void detach() {
+        if(features.unique())
+            return;
+
+        features = make_shared<AlignedVector<double> >(*features);
+
+        if(HNSWGraph *graph = dynamic_cast<HNSWGraph *>(spatialIndex.get())) {
+            shared_ptr<HNSWGraph> copy = make_shared<HNSWGraph>(*graph);
+            copy->add(features->data(), nElements);
+            spatialIndex = copy;
+        } else
+            buildIndex();
+    }
+
+    // ! Memory reused across the queries answered by one thread
+    struct QueryBuffers {
+        // features of the query, without the y column and padded like the rows of the feature buffer
+        AlignedVector<double> query;
+        NeighborHeap heap;
+        // distinct classes among the neighbors and their number of votes
+        vector<double> classes;
+        vector<int> votes;
+    };
+
+    // ! Checks whether a set of data elements can be queried, before any work is split among threads
+    void validateQueries(const vector<vector<double> > &test) const {
+        if(k < 1 or static_cast<size_t>(k) > nElements)
+            throw invalid_argument("k must be between 1 and the number of elements in the data set");
+
+        for(const vector<double> &testie : test)
+            if(testie.size() < nFeatures + (yColumn < testie.size()))
+                throw invalid_argument("Data element has fewer features than the data set");
+    }
 
     // ! Finds the k-nearest neighbors of a data element
-    // ! \param chosen_indices integer array that will keep the indices of the k-nearest neighbors
     // ! \param testie a vector of real values representing a data element
-    void getKNN(int *chosen_indices, const vector<double> &testie) {
+    // ! \param buffers memory used by the query
+    // ! \return pairs of (distance, index) of the k-nearest neighbors, from the closest to the farthest
+    const vector<pair<double, size_t> > &getKNN(const vector<double> &testie, QueryBuffers &buffers) const {
+        // the query is compared against the stored features, so its y column is dropped as well
+        AlignedVector<double> &query = buffers.query;
+        query.assign(rowStride, 0);
+
+        for(size_t j = 0, f = 0; f < nFeatures; j++)
+            if(j != yColumn)
+                query[f++] = testie[j];
+
+        NeighborHeap &heap = buffers.heap;
+        heap.reset(k);
+
+        if(spatialIndex)
+            spatialIndex->query(query.data(), heap);
+        else {
+            const double *row = features->data();
+
+            for(size_t i = 0; i < nElements; i++, row += rowStride)
+                heap.offer(distance == EUCLIDEAN ? sqrt(SpatialIndex::squaredEuclidean(query.data(), row, rowStride))
+                                                 : SpatialIndex::hamming(query.data(), row, rowStride), i);
+        }
 
-        // initialize two arrays with indices of the k nearest neighbors in our data
-        // and their distances from our new element
-        double chosen_distances[k];
+        return heap.sorted();
+    }
 
-        int largestDistanceIndex = 0;
-        double largestCandidateDistance = distance == EUCLIDEAN ? euclidean(testie, data[0]) : hamming(testie, data[0]);;
+    double regression(const vector<double> &testie, QueryBuffers &buffers) const {
+        const vector<pair<double, size_t> > &neighbors = getKNN(testie, buffers);
 
-        for(int i = 0; i < data.size(); i++) {
-            // get the euclidean euclidean from the new element to the current element in our dataset
-            double current_distance = distance == EUCLIDEAN ? euclidean(testie, data[i]) : hamming(testie, data[i]);
+        // return the mean value of the y column
+        double ySum = 0;
 
-            // first, fill the array with the first k candidates
-            if(i < k) {
-                chosen_indices[i] = i;
-                chosen_distances[i] = current_distance;
+        for(const pair<double, size_t> &neighbor : neighbors)
+            ySum += labels[neighbor.second];
 
-                if(current_distance >= largestCandidateDistance) {
-                    largestDistanceIndex = i;
-                    largestCandidateDistance = current_distance;
-                }
+        return ySum / k;
+    }
+
+    double classify(const vector<double> &testie, QueryBuffers &buffers) const {
+        const vector<pair<double, size_t> > &neighbors = getKNN(testie, buffers);
+        vector<double> &classes = buffers.classes;
+        vector<int> &votes = buffers.votes;
+        classes.clear();
+        votes.clear();
+
+        // sum the occurrences of each class
+        for(const pair<double, size_t> &neighbor : neighbors) {
+            double currentClass = labels[neighbor.second];
+            size_t i = static_cast<size_t>(find(classes.begin(), classes.end(), currentClass) - classes.begin());
+
+            if(i == classes.size()) {
+                classes.push_back(currentClass);
+                votes.push_back(0);
             }
-            // then, look for the furthest neighbor candidate and check if ours is closer
-            else if(current_distance < largestCandidateDistance) {
 
-                // if it is, replace the furthest one with the current one
-                chosen_indices[largestDistanceIndex] = i;
-                chosen_distances[largestDistanceIndex] = current_distance;
+            votes[i]++;
+        }
+
+        // get the class with the most votes. Classes are listed in the order of their nearest neighbor,
+        // so ties go to the class of the closest one
+        size_t winner = static_cast<size_t>(max_element(votes.begin(), votes.end()) - votes.begin());
+        return classes[winner];
+    }
+
+    // ! Answers a set of queries in parallel. Threads take queries dynamically, since the cost of searching the
+    // ! spatial index varies from one query to the other, and each thread reuses its own buffers
+    // ! \param test data elements
+    // ! \param verbose whether to print an estimate of the remaining time, in minutes, every 100 queries
+    // ! \param classification whether to classify the data elements or to perform regression
+    // ! \return one prediction per data element
+    vector<double> predict(const vector<vector<double> > &test, bool verbose, bool classification) const {
+        validateQueries(test);
+
+        size_t totalSize = test.size(), done = 0;
+        vector<double> y(totalSize);
+
+        using clock = chrono::high_resolution_clock;
+        chrono::time_point<chrono::system_clock> start = clock::now();
+
+        #pragma omp parallel
+        {
+            QueryBuffers buffers;
 
-                // look, in the k candidates, the furthest one
-                largestDistanceIndex = 0;
-                largestCandidateDistance = chosen_distances[0];
+            #pragma omp for schedule(dynamic, 16)
+            for(size_t i = 0; i < totalSize; i++) {
+                y[i] = classification ? classify(test[i], buffers) : regression(test[i], buffers);
 
-                for(int j = 1; j < k; j++) {
-                    if(largestCandidateDistance < chosen_distances[j]) {
-                        largestDistanceIndex = j;
-                        largestCandidateDistance = chosen_distances[j];
+                if(verbose) {
+                    size_t current;
+
+                    #pragma omp atomic capture
+                    current = ++done;
+
+                    if(current % 100 == 0) {
+                        float tempo = ((chrono::duration<float>) (clock::now() - start)).count();
+                        float total = tempo / current * totalSize;
+
+                        #pragma omp critical
+                        cout << (total - tempo) / 60 << endl;
                     }
                 }
             }
         }
+
+        return y;
     }
 
 public:
@@ -86,23 +246,35 @@ public:
         KNN::k = k;
     }
 
-    const vector<vector<double> > &getData() const {
+    // ! \return the data set, rebuilt from the feature buffer and the labels, sorted in the order used internally
+    vector<vector<double> > getData() const {
+        vector<vector<double> > data(nElements);
+
+        for(size_t i = 0; i < nElements; i++) {
+            const double *row = &(*features)[i * rowStride];
+            data[i].assign(row, row + nFeatures);
+
+            if(yColumn <= nFeatures)
+                data[i].insert(data[i].begin() + yColumn, labels[i]);
+        }
+
         return data;
     }
 
     int getYColumn() const {
-        return yColumn;
+        return static_cast<int>(yColumn);
     }
 
     // ! k-nearest neighbors algorithm, able to do regression and classification
     // ! \param data a dataset, where each vector represents a data element
     // ! \param yColumn which column of the dataset is the dependent variable
     // ! \param k number of nearest neighbors
-    explicit KNN(vector<vector<double> > data, int yColumn, int k = 1, Distance distance = EUCLIDEAN) {
-        this->data = std::move(data);
-
-        sort(this->data.begin(), this->data.end(), [](const vector<double> &a, const vector<double> &b) {
-            for(int i = 0; i < a.size(); i++) {
+    // ! \param distance distance function used to compare data elements
+    // ! \param index structure used to find the nearest neighbors
+    explicit KNN(vector<vector<double> > data, int yColumn, int k = 1, Distance distance = EUCLIDEAN,
+        Index index = AUTOMATIC) : hnswM(16), efConstruction(200), efSearch(50) {
+        sort(data.begin(), data.end(), [](const vector<double> &a, const vector<double> &b) {
+            for(size_t i = 0; i < a.size(); i++) {
                 if(a[i] < b[i])
                     return true;
 
@@ -113,147 +285,169 @@ public:
             return false;
         });
 
-        this->yColumn = yColumn;
+        if(yColumn < 0)
+            throw invalid_argument("The column of the dependent variable must not be negative");
+
+        this->yColumn = static_cast<size_t>(yColumn);
         this->k = k;
         this->distance = distance;
+        this->index = index;
+
+        // split the data set into the feature buffer and the label array
+        nElements = data.size();
+        nFeatures = data.empty() ? 0 : data[0].size() - (this->yColumn < data[0].size());
+        rowStride = (nFeatures + SIMD_WIDTH - 1) / SIMD_WIDTH * SIMD_WIDTH;
+        features = make_shared<AlignedVector<double> >(nElements * rowStride, 0);
+        labels = vector<double>(nElements, 0);
+
+        for(size_t i = 0; i < nElements; i++) {
+            double *row = &(*features)[i * rowStride];
+
+            for(size_t j = 0, f = 0; f < nFeatures; j++) {
+                if(j == this->yColumn)
+                    labels[i] = data[i][j];
+                else
+                    row[f++] = data[i][j];
+            }
+
+            // the label may come after the features
+            if(this->yColumn >= nFeatures and this->yColumn < data[i].size())
+                labels[i] = data[i][this->yColumn];
+        }
+
+        buildIndex();
     }
 
-    // ! Calculates the Euclidean distance between two vectors
+    // ! Calculates the Euclidean distance between two vectors, ignoring the dependent variable column
     // ! \param a first vector
     // ! \param b second vector
     // ! \return Euclidean distance between a and b
-    double euclidean(vector<double> a, vector<double> b) {
-        double d = 0;
-
-        for(int i = 0; i < a.size(); i++) {
-            // ignore our dependent variable column
-            if(i == yColumn)
-                continue;
-
-            d += pow(a[i] - b[i], 2);
-        }
-
-        return sqrt(d);
+    double euclidean(const vector<double> &a, const vector<double> &b) const {
+        // the features before and after the y column are compared as two separate spans, without branches
+        size_t before = min<size_t>(yColumn, a.size()), after = min(before + 1, a.size());
+        return sqrt(SpatialIndex::squaredEuclidean(a.data(), b.data(), before)
+                    + SpatialIndex::squaredEuclidean(a.data() + after, b.data() + after, a.size() - after));
     }
 
-    // ! Calculates the Hamming distance between two vectors
+    // ! Calculates the Hamming distance between two vectors, ignoring the dependent variable column
     // ! \param a first vector
     // ! \param b second vector
     // ! \return Hamming distance between a and b
-    double hamming(vector<double> a, vector<double> b) {
-        double d = 0;
-
-        for(int i = 0; i < a.size(); i++) {
-            // ignore our dependent variable column
-            if(i == yColumn)
-                continue;
-
-            d += a[i] != b[i];
-        }
-
-        return d;
+    double hamming(const vector<double> &a, const vector<double> &b) const {
+        size_t before = min<size_t>(yColumn, a.size()), after = min(before + 1, a.size());
+        return SpatialIndex::hamming(a.data(), b.data(), before)
+               + SpatialIndex::hamming(a.data() + after, b.data() + after, a.size() - after);
     }
 
-    // ! Perform regression using
-    // ! \param testie
-    // ! \return
-    double regression(const vector<double> &testie) {
-        // get the indices of the k-nearest neighbors
-        int chosen_indices[k];
-        getKNN(chosen_indices, testie);
+    // ! Adds a data element to the data set. An HNSW graph is updated incrementally, other indices are rebuilt
+    // ! \param element a vector of real values, including the dependent variable at the y column
+    void insert(const vector<double> &element) {
+        if(element.size() < nFeatures + 1 or yColumn >= element.size())
+            throw invalid_argument("Data element must have all features and the dependent variable");
 
-        // sum the y column
-        double ySum = 0;
+        detach();
+        features->resize((nElements + 1) * rowStride, 0);
+        double *row = &(*features)[nElements * rowStride];
 
-    #pragma omp parallel for reduction(+:ySum)
+        for(size_t j = 0, f = 0; f < nFeatures; j++)
+            if(j != yColumn)
+                row[f++] = element[j];
 
-        for(int j = 0; j < k; j++) {
-            ySum += data[chosen_indices[j]][yColumn];
-        }
+        labels.push_back(element[yColumn]);
+        nElements++;
 
-        // return its mean value
-        return ySum / k;
+        if(HNSWGraph *graph = dynamic_cast<HNSWGraph *>(spatialIndex.get()))
+            graph->add(features->data(), nElements);
+        else
+            buildIndex();
     }
 
-    double classify(const vector<double> &testie) {
-        // get the indices of the k-nearest neighbors
-        int chosen_indices[k];
-        getKNN(chosen_indices, testie);
-
-        // initialize vectors that will hold individual classes and their number of appearances in the knn
-        int class_votes[k] = {0};
-        vector<double> classes;
-
-        // sum the occurrences of each class
-        class_votes[0] = 1;
-        classes.push_back(data[chosen_indices[0]][yColumn]);
-
-        for(int j = 1; j < k; j++) {
-            double current_class = data[chosen_indices[j]][yColumn];
-
-            for(int i = 0; i < classes.size(); i++) {
-                if(classes[i] == current_class) {
-                    class_votes[i]++;
-                    break;
-                }
-            }
-        }
-
-        // get the class with the most votes
-        double winner = classes[0];
-        int winner_votes = class_votes[0];
+    // ! Finds the k-nearest neighbors of a data element
+    // ! \param testie a vector of real values representing a data element
+    // ! \return indices of the neighbors in getData(), from the closest to the farthest
+    vector<size_t> getNeighbors(const vector<double> &testie) const {
+        validateQueries(vector<vector<double> >(1, testie));
+        QueryBuffers buffers;
+        vector<size_t> indices;
 
-        for(int j = 1; j < k; j++) {
-            if(class_votes[j] > winner_votes) {
-                winner = classes[j];
-                winner_votes = class_votes[j];
-            }
-        }
+        for(const pair<double, size_t> &neighbor : getKNN(testie, buffers))
+            indices.push_back(neighbor.second);
 
-        return winner;
+        return indices;
     }
 
-    vector<double> classify(const vector<vector<double> > &test, bool verbose = false) {
-        vector<double> y;
-        unsigned long totalSize = test.size();
+    // ! Estimates the dependent variable of a data element as the mean of the values of its k-nearest neighbors
+    // ! \param testie a vector of real values representing a data element
+    // ! \return estimated value of the dependent variable
+    double regression(const vector<double> &testie) const {
+        validateQueries(vector<vector<double> >(1, testie));
+        QueryBuffers buffers;
+        return regression(testie, buffers);
+    }
 
-        using clock = chrono::high_resolution_clock;
-        chrono::time_point<chrono::system_clock> start = clock::now();
+    // ! Classifies a data element by majority vote of its k-nearest neighbors
+    // ! \param testie a vector of real values representing a data element
+    // ! \return the most voted class
+    double classify(const vector<double> &testie) const {
+        validateQueries(vector<vector<double> >(1, testie));
+        QueryBuffers buffers;
+        return classify(testie, buffers);
+    }
 
-        for(int i = 0; i < test.size(); i++) {
-            if(verbose and i % 100 == 0) {
-                float tempo = ((chrono::duration<float>)(clock::now() - start)).count();
-                float media = tempo / (i + 1);
-                float total = media * totalSize;
-                cout << (total - tempo) / 60 << endl;
-            }
+    vector<double> classify(const vector<vector<double> > &test, bool verbose = false) const {
+        return predict(test, verbose, true);
+    }
 
-            y.push_back(classify(test[i]));
-        }
+    vector<double> regression(const vector<vector<double> > &test, bool verbose = false) const {
+        return predict(test, verbose, false);
+    }
 
-        return y;
+    Distance getDistance() const {
+        return distance;
     }
 
-    vector<double> regression(const vector<vector<double> > &test, bool verbose = false) {
-        vector<double> y;
-        unsigned long totalSize = test.size();
+    void setDistance(Distance distance) {
+        KNN::distance = distance;
+        buildIndex();
+    }
 
-        for(int i = 0; i < test.size(); i++) {
-            if(verbose and i % (totalSize / 100) == 0)
-                cout << totalSize / (i + 1);
+    Index getIndex() const {
+        return index;
+    }
 
-            y.push_back(regression(test[i]));
-        }
+    void setIndex(Index index) {
+        KNN::index = index;
+        buildIndex();
+    }
 
-        return y;
+    // ! Sets the parameters of the HNSW graph, rebuilding it if it is in use
+    // ! \param M maximum number of links per node in the upper layers of the graph; layer 0 allows 2M
+    // ! \param efConstruction width of the beam used to find the neighbors of inserted elements
+    // ! \param efSearch width of the beam used by queries. Larger values increase recall and query time
+    void setHNSWParameters(size_t M, size_t efConstruction, size_t efSearch) {
+        hnswM = M;
+        KNN::efConstruction = efConstruction;
+        KNN::efSearch = efSearch;
+
+        if(index == HNSW)
+            buildIndex();
     }
 
-    Distance getDistance() const {
-        return distance;
+    size_t getEfSearch() const {
+        return efSearch;
     }
 
-    void setDistance(Distance distance) {
-        KNN::distance = distance;
+    // ! Sets the width of the beam used by HNSW queries, which does not require rebuilding the graph
+    void setEfSearch(size_t efSearch) {
+        KNN::efSearch = efSearch;
+
+        if(HNSWGraph *graph = dynamic_cast<HNSWGraph *>(spatialIndex.get())) {
+            // copies of this object keep their own beam width
+            shared_ptr<HNSWGraph> copy = spatialIndex.unique() ? static_pointer_cast<HNSWGraph>(spatialIndex)
+                                                               : make_shared<HNSWGraph>(*graph);
+            copy->setEfSearch(efSearch);
+            spatialIndex = copy;
+        }
     }
 };
 
@@ -8,18 +8,120 @@
 #define MACHINE_LEARNING_LDA_HPP
 
 #include <utility>
+#include <vector>
+#include <algorithm>
+#include <cmath>
+#include <omp.h>
 
 #include "../include/matrix/Matrix.hpp"
+#include "MatrixView.hpp"
+#include "Gemm.hpp"
+#include "Cholesky.hpp"
+#include "SymmetricEigen.hpp"
 
 using namespace std;
 
 
 /**
- * Linear discriminant analysis algorithm
+ * Linear discriminant analysis algorithm.
+ *
+ * The within-class and between-class scatter matrices are computed in a single parallel pass over the data set.
+ * The discriminants solve the generalized symmetric eigenproblem Sb v = lambda Sw v, which is reduced to a standard
+ * one by the Cholesky decomposition Sw = LL': the eigenvectors w of L^-1 Sb L^-T give v = L^-T w. Sb has rank at most
+ * the number of classes minus one, so only that many discriminants are kept.
  */
 class LDA {
 private:
-    MatrixD X, y, eigenvalues, eigenvectors, transformedData;
+    // number of rows whose outer products are accumulated by each GEMM in the scatter pass
+    enum { TILE = 256 };
+
+    MatrixD X, y, eigenvalues, eigenvectors;
+
+    // ! Within-class and between-class scatter matrices, in one pass over the data set. Each thread accumulates the
+    // ! outer products of tiles of rows with a GEMM, along with per-class sums and counts; partial results are merged
+    // ! in thread order. Rows are shifted by the first row, which leaves both matrices unchanged and avoids the
+    // ! cancellation of subtracting large sums of products
+    // ! \param labels class index of each row
+    // ! \param nClasses number of classes
+    pair<MatrixD, MatrixD> scatterMatrices(const vector<uint32_t> &labels, size_t nClasses) const {
+        size_t n = X.nRows(), d = X.nCols();
+        const double *x = Gemm::data(X);
+        vector<vector<double> > crossProducts, sums;
+        vector<vector<size_t> > counts;
+
+        #pragma omp parallel if(n * d * d > 65536)
+        {
+            #pragma omp single
+            {
+                size_t threads = static_cast<size_t>(omp_get_num_threads());
+                crossProducts.resize(threads);
+                sums.resize(threads);
+                counts.resize(threads);
+            }
+
+            size_t thread = static_cast<size_t>(omp_get_thread_num());
+            vector<double> &cross = crossProducts[thread], &classSums = sums[thread];
+            vector<size_t> &classCounts = counts[thread];
+            cross.assign(d * d, 0);
+            classSums.assign(nClasses * d, 0);
+            classCounts.assign(nClasses, 0);
+            vector<double> tile(TILE * d);
+
+            #pragma omp for schedule(static)
+            for(size_t t0 = 0; t0 < n; t0 += TILE) {
+                size_t rows = min<size_t>(TILE, n - t0);
+
+                for(size_t i = 0; i < rows; i++) {
+                    uint32_t label = labels[t0 + i];
+                    classCounts[label]++;
+
+                    for(size_t j = 0; j < d; j++) {
+                        double shifted = x[(t0 + i) * d + j] - x[j];
+                        tile[i * d + j] = shifted;
+                        classSums[label * d + j] += shifted;
+                    }
+                }
+
+                Gemm::gemm<double>(d, d, rows, 1, tile.data(), 1, d, tile.data(), d, 1, 1, cross.data(), d);
+            }
+        }
+
+        for(size_t t = 1; t < crossProducts.size(); t++) {
+            for(size_t e = 0; e < d * d; e++)
+                crossProducts[0][e] += crossProducts[t][e];
+
+            for(size_t e = 0; e < nClasses * d; e++)
+                sums[0][e] += sums[t][e];
+
+            for(size_t c = 0; c < nClasses; c++)
+                counts[0][c] += counts[t][c];
+        }
+
+        // Sw = sum of x x' - sum over classes of n_c m_c m_c'
+        // Sb = sum over classes of n_c (m_c - m)(m_c - m)'
+        MatrixD Sw(d, d, crossProducts[0]), Sb = MatrixD::zeros(d, d);
+        vector<double> grandMean(d, 0), classMean(d);
+
+        for(size_t c = 0; c < nClasses; c++)
+            for(size_t j = 0; j < d; j++)
+                grandMean[j] += sums[0][c * d + j] / n;
+
+        for(size_t c = 0; c < nClasses; c++) {
+            double count = counts[0][c];
+
+            for(size_t j = 0; j < d; j++)
+                classMean[j] = sums[0][c * d + j] / count;
+
+            for(size_t i = 0; i < d; i++)
+                for(size_t j = 0; j < d; j++) {
+                    Sw(i, j) -= count * classMean[i] * classMean[j];
+                    Sb(i, j) += count * (classMean[i] - grandMean[i]) * (classMean[j] - grandMean[j]);
+                }
+        }
+
+        return make_pair(Sw, Sb);
+    }
+
 public:
 
     /**
@@ -28,31 +130,85 @@ public:
      * @param classes Column vector containing the classes each row element in <code>data</code> belongs to
      */
     LDA(MatrixD data, MatrixD classes) : X(std::move(data)), y(std::move(classes)) {
-        if(data.nRows() != classes.nRows())
+        if(X.nRows() != y.nRows())
             throw invalid_argument("data and classes must have the same number of rows");
 
-        if(classes.nCols() != 1)
+        if(y.nCols() != 1)
             throw invalid_argument("classes must me a column vector");
     }
 
+    /**
+     * Finds the linear discriminants of the data set, in O(n d² + d³). Throws if the within-class scatter matrix is
+     * singular, which happens when features are linearly dependent within every class
+     */
     void fit() {
-        MatrixD Sw = X.WithinClassScatter(y);
-        MatrixD Sb = X.BetweenClassScatter(y);
+        size_t n = X.nRows(), d = X.nCols();
+
+        // class of each element, as an index into the sorted distinct classes
+        vector<double> classes(Gemm::data(y), Gemm::data(y) + n);
+        sort(classes.begin(), classes.end());
+        classes.erase(unique(classes.begin(), classes.end()), classes.end());
+
+        if(classes.size() < 2)
+            throw invalid_argument("At least two classes are needed to find linear discriminants");
+
+        vector<uint32_t> labels(n);
+
+        for(size_t i = 0; i < n; i++)
+            labels[i] = static_cast<uint32_t>(lower_bound(classes.begin(), classes.end(), y(i, 0)) - classes.begin());
+
+        pair<MatrixD, MatrixD> scatter = scatterMatrices(labels, classes.size());
+
+        // L^-1 Sb L^-T, computed as L^-1 (L^-1 Sb)', since Sb is symmetric
+        Cholesky cholesky(scatter.first);
+        MatrixD whitened = cholesky.solveLower(cholesky.solveLower(scatter.second).transpose());
+
+        size_t count = min(classes.size() - 1, d);
+        SymmetricEigen eig(whitened, count);
+
+        eigenvalues = MatrixViewD(eig.getEigenvalues()).rows(0, count).copy();
+        eigenvectors = cholesky.solveUpper(eig.getEigenvectors());
 
-        auto eigen = (Sw.inverse() * Sb).eigen();
+        // eigenvectors with unit length
+        for(size_t j = 0; j < count; j++) {
+            double norm = 0;
 
-        eigenvalues = eigen.first;
-        eigenvectors = eigen.second;
+            for(size_t i = 0; i < d; i++)
+                norm += eigenvectors(i, j) * eigenvectors(i, j);
 
-        transformedData = (eigenvectors.transpose() * X.transpose()).transpose();
+            for(size_t i = 0; norm > 0 and i < d; i++)
+                eigenvectors(i, j) /= sqrt(norm);
+        }
+    }
+
+    /**
+     * Projects elements onto the linear discriminants found by <code>fit()</code>
+     * @param data a Matrix, or a view of one, containing elements in rows and the fitted features in columns
+     * @return n x (classes - 1) matrix with the projected elements
+     */
+    MatrixD transform(MatrixViewD data) const {
+        if(data.nCols() != eigenvectors.nRows())
+            throw invalid_argument("Data must have the features LDA was fit on");
+
+        return Gemm::multiply(data, MatrixViewD(eigenvectors));
     }
 
     /**
      * Transforms the data matrix using the eigenvectors found by <code>fit()</code>
      * @return
      */
-    MatrixD transform() {
-        return transformedData;
+    MatrixD transform() const {
+        return transform(X);
+    }
+
+    // ! \return eigenvalues of the discriminants, in decreasing order
+    const MatrixD &getEigenvalues() const {
+        return eigenvalues;
+    }
+
+    // ! \return matrix whose columns are the linear discriminants
+    const MatrixD &getEigenvectors() const {
+        return eigenvectors;
     }
 };
 
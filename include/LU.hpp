@@ -0,0 +1,256 @@
+/**
+ * @author Douglas De Rizzo Meneghetti (douglasrizzom@gmail.com)
+ * @brief  LU decomposition with partial pivoting
+ * @date   2026-10-16
+ */
+
+#ifndef MACHINE_LEARNING_LU_HPP
+#define MACHINE_LEARNING_LU_HPP
+
+#include <vector>
+#include <cmath>
+#include <limits>
+#include <stdexcept>
+#include "../include/matrix/Matrix.hpp"
+#include "Gemm.hpp"
+
+using namespace std;
+
+
+/**
+ * LU decomposition with partial pivoting, PA = LU.
+ *
+ * The factorization is computed once, in O(n³), and then reused to solve linear systems, invert the matrix or
+ * calculate its determinant. Columns are factorized in panels; after each panel, the rows to its right are
+ * updated with a triangular solve and the rest of the matrix with a single GEMM, both parallelized with OpenMP.
+ */
+class LU {
+private:
+    // number of columns factorized in each panel
+    enum { PANEL = 64 };
+
+    size_t n;
+    // L (below the diagonal, unit diagonal implied) and U (diagonal and above), stored row-major
+    vector<double> lu;
+    // row i of PA is row permutation[i] of A
+    vector<size_t> permutation;
+    int pivotSign;
+    bool singular;
+
+    double &at(size_t i, size_t j) {
+        return lu[i * n + j];
+    }
+
+    double at(size_t i, size_t j) const {
+        return lu[i * n + j];
+    }
+
+    // ! Unblocked factorization of columns [k0, k1), searching pivots in rows k0 to n - 1.
+    // ! Row swaps are applied to entire rows, so the parts of L to the left and of A to the right stay consistent
+    void factorizePanel(size_t k0, size_t k1) {
+        for(size_t j = k0; j < k1; j++) {
+            size_t p = j;
+
+            for(size_t i = j + 1; i < n; i++)
+                if(abs(at(i, j)) > abs(at(p, j)))
+                    p = i;
+
+            if(p != j) {
+                swap_ranges(lu.begin() + p * n, lu.begin() + (p + 1) * n, lu.begin() + j * n);
+                swap(permutation[p], permutation[j]);
+                pivotSign = -pivotSign;
+            }
+
+            double pivot = at(j, j);
+
+            if(pivot == 0) {
+                singular = true;
+                continue;
+            }
+
+            #pragma omp parallel for if((n - j) * (k1 - j) > 16384)
+            for(size_t i = j + 1; i < n; i++) {
+                double l = at(i, j) /= pivot;
+
+                for(size_t c = j + 1; c < k1; c++)
+                    at(i, c) -= l * at(j, c);
+            }
+        }
+    }
+
+    // ! Applies the row permutation to the rows of b, returning them as a row-major n x m buffer
+    vector<double> permute(const MatrixD &b) const {
+        size_t m = b.nCols();
+        vector<double> x(n * m);
+        const double *data = Gemm::data(b);
+
+        for(size_t i = 0; i < n; i++)
+            copy(data + permutation[i] * m, data + (permutation[i] + 1) * m, x.begin() + i * m);
+
+        return x;
+    }
+
+public:
+
+    // ! Factorizes a square matrix
+    // ! \param a the matrix to be factorized
+    explicit LU(const MatrixD &a) : n(a.nRows()), pivotSign(1), singular(false) {
+        if(!a.isSquare())
+            throw runtime_error("Cannot factorize a non-square matrix");
+
+        const double *data = Gemm::data(a);
+        lu = vector<double>(data, data + n * n);
+        permutation = vector<size_t>(n);
+
+        for(size_t i = 0; i < n; i++)
+            permutation[i] = i;
+
+        for(size_t k = 0; k < n; k += PANEL) {
+            size_t kEnd = min<size_t>(k + PANEL, n);
+            factorizePanel(k, kEnd);
+
+            if(kEnd == n)
+                break;
+
+            // U12 = L11^-1 A12, each column of A12 solved independently
+            #pragma omp parallel for if((n - kEnd) * (kEnd - k) > 16384)
+            for(size_t c = kEnd; c < n; c++)
+                for(size_t i = k + 1; i < kEnd; i++)
+                    for(size_t j = k; j < i; j++)
+                        at(i, c) -= at(i, j) * at(j, c);
+
+            // A22 = A22 - L21 U12
+            size_t rest = n - kEnd;
+            Gemm::gemm<double>(rest, rest, kEnd - k, -1,
+                &at(kEnd, k), n, 1,
+                &at(k, kEnd), n, 1,
+                1, &at(kEnd, kEnd), n);
+        }
+    }
+
+    // ! \return whether the factorized matrix is singular
+    bool isSingular() const {
+        return singular;
+    }
+
+    // ! Solves the linear system AX = B, without forming the inverse of A
+    // ! \param b a matrix with as many rows as A, each of its columns a right-hand side
+    // ! \return the matrix X
+    MatrixD solve(const MatrixD &b) const {
+        if(b.nRows() != n)
+            throw invalid_argument(
+                "Cannot solve the system: A = " + to_string(n) + "x" + to_string(n) + ", B = "
+                + to_string(b.nRows()) + "x" + to_string(b.nCols()));
+
+        if(singular)
+            throw runtime_error("Matrix is singular");
+
+        size_t m = b.nCols();
+        vector<double> x = permute(b);
+
+        // right-hand sides are independent, so they are split among threads in blocks of columns
+        #pragma omp parallel for if(n * n * m > 65536)
+        for(size_t c0 = 0; c0 < m; c0 += 64) {
+            size_t c1 = min<size_t>(c0 + 64, m);
+
+            // forward substitution, Ly = Pb
+            for(size_t i = 1; i < n; i++)
+                for(size_t j = 0; j < i; j++) {
+                    double l = at(i, j);
+
+                    for(size_t c = c0; c < c1; c++)
+                        x[i * m + c] -= l * x[j * m + c];
+                }
+
+            // back substitution, Ux = y
+            for(size_t i = n; i-- > 0;) {
+                for(size_t j = i + 1; j < n; j++) {
+                    double u = at(i, j);
+
+                    for(size_t c = c0; c < c1; c++)
+                        x[i * m + c] -= u * x[j * m + c];
+                }
+
+                double pivot = at(i, i);
+
+                for(size_t c = c0; c < c1; c++)
+                    x[i * m + c] /= pivot;
+            }
+        }
+
+        return MatrixD(n, m, x);
+    }
+
+    // ! \return the inverse of the factorized matrix
+    MatrixD inverse() const {
+        return solve(MatrixD::identity(n));
+    }
+
+    // ! \return the determinant of the factorized matrix, the product of the diagonal of U
+    double determinant() const {
+        double det = pivotSign;
+
+        for(size_t i = 0; i < n; i++)
+            det *= at(i, i);
+
+        return det;
+    }
+
+    // ! Natural logarithm of the absolute value of the determinant, which does not overflow for large matrices
+    // ! \return log |det(A)|, or -infinity if the matrix is singular
+    double logDeterminant() const {
+        if(singular)
+            return -numeric_limits<double>::infinity();
+
+        double logDet = 0;
+
+        for(size_t i = 0; i < n; i++)
+            logDet += log(abs(at(i, i)));
+
+        return logDet;
+    }
+
+    // ! \return the sign of the determinant (-1, 0 or 1)
+    int determinantSign() const {
+        if(singular)
+            return 0;
+
+        int sign = pivotSign;
+
+        for(size_t i = 0; i < n; i++)
+            if(at(i, i) < 0)
+                sign = -sign;
+
+        return sign;
+    }
+
+    // ! \return the unit lower triangular factor L
+    MatrixD getL() const {
+        MatrixD L = MatrixD::identity(n);
+
+        for(size_t i = 1; i < n; i++)
+            for(size_t j = 0; j < i; j++)
+                L(i, j) = at(i, j);
+
+        return L;
+    }
+
+    // ! \return the upper triangular factor U
+    MatrixD getU() const {
+        MatrixD U = MatrixD::zeros(n, n);
+
+        for(size_t i = 0; i < n; i++)
+            for(size_t j = i; j < n; j++)
+                U(i, j) = at(i, j);
+
+        return U;
+    }
+
+    // ! \return the row permutation, so that row i of PA is row <code>getPermutation()[i]</code> of A
+    const vector<size_t> &getPermutation() const {
+        return permutation;
+    }
+};
+
+
+#endif // MACHINE_LEARNING_LU_HPP
@@ -7,25 +7,76 @@
 
 #include <utility>
 #include <vector>
+#include <cmath>
 #include "../include/matrix/Matrix.hpp"
+#include "Gemm.hpp"
+#include "QR.hpp"
+#include "Cholesky.hpp"
+#include "MatrixView.hpp"
+#include "Expression.hpp"
 
 using namespace std;
 
 
 /**
- * Ordinary and weighted Least squares algorithm
+ * Ordinary and weighted Least squares algorithm, with optional ridge regularization.
+ *
+ * Weights are kept as a vector and applied by scaling the rows of X and y by their square roots, so no n x n
+ * matrix is ever formed and memory is linear in the number of elements. The problem is solved through a Householder
+ * QR decomposition of the scaled X, which is the most accurate option, or through a Cholesky decomposition of the
+ * d x d Gram matrix X'WX, which is faster when there are many more elements than features.
  */
 class LeastSquares {
 public:
     enum RegressionType {
         REGULAR, WEIGHTED
     };
+    // ! How the normal equations are solved. QR never forms X'WX, CHOLESKY forms it with a single GEMM
+    enum Solver {
+        QR_DECOMPOSITION, CHOLESKY
+    };
 private:
     MatrixD X, y, coefs, residuals;
     RegressionType regressionType;
+    Solver solver;
+    double ridge;
+
+    // ! \return the weight of each element. Weighted regression uses the variance of the values of each element
+    vector<double> weights() const {
+        vector<double> w(X.nRows(), 1);
+
+        if(regressionType == WEIGHTED) {
+            MatrixD vars = MatrixViewD(X).transpose().var();
+
+            for(size_t i = 0; i < w.size(); i++)
+                w[i] = vars(i, 0);
+        }
+
+        return w;
+    }
+
+    // ! Multiplies each row of a matrix by the square root of its weight
+    static MatrixD scaleRows(const MatrixD &m, const vector<double> &w) {
+        MatrixD result = m;
+        double *r = Gemm::data(result);
+        size_t cols = m.nCols();
+
+        #pragma omp parallel for if(m.nRows() * cols > 65536)
+        for(size_t i = 0; i < m.nRows(); i++) {
+            double root = sqrt(w[i]);
+
+            for(size_t j = 0; j < cols; j++)
+                r[i * cols + j] *= root;
+        }
+
+        return result;
+    }
+
 public:
 
-    LeastSquares(MatrixD data, MatrixD labels, RegressionType regType = REGULAR) : regressionType(regType) {
+    LeastSquares(MatrixD data, MatrixD labels, RegressionType regType = REGULAR) : regressionType(regType),
+                                                                                    solver(QR_DECOMPOSITION),
+                                                                                    ridge(0) {
         X = std::move(data);
         X.addColumn(MatrixD::ones(X.nRows(), 1), 0);
         y = std::move(labels);
@@ -39,6 +90,26 @@ public:
         this->regressionType = regressionType;
     }
 
+    Solver getSolver() const {
+        return solver;
+    }
+
+    void setSolver(Solver solver) {
+        this->solver = solver;
+    }
+
+    double getRidge() const {
+        return ridge;
+    }
+
+    // ! Sets the ridge penalty, lambda ||B||², added to the squared residuals. The intercept is not penalized
+    void setRidge(double ridge) {
+        if(ridge < 0)
+            throw invalid_argument("Ridge penalty must not be negative");
+
+        this->ridge = ridge;
+    }
+
     void fit() {
         // The formula for least squares is the following
         // B^ = (X'X)^{-1} X'y
@@ -46,28 +117,52 @@ public:
         // B^ = (X'WX)^{-1} X'Wy
         // where W is a Square matrix with the weights in the diagonal
         // if W = I, weighted least squares behaves just like ordinary least squares
-
-        MatrixD W;
-
-        if(regressionType == WEIGHTED) {
-            MatrixD vars = X.transpose().var();
-            W = vars.asDiagonal();
-        } else
-            W = MatrixD::identity(X.nRows());
-
-        MatrixD Xt = X.transpose();
-        MatrixD first_part = Xt * W * X;
-        first_part = first_part.inverse();
-        MatrixD second_part = Xt * W * y;
-        coefs = first_part * second_part;
-
-        residuals = y - (X * coefs);
-        residuals = residuals.transpose() * residuals;
+        // with W^1/2 applied to the rows of X and y, both become ordinary least squares problems, min ||Ax - b||.
+        // A ridge penalty adds lambda to the diagonal of X'WX, except for the intercept
+        size_t n = X.nRows(), d = X.nCols();
+        vector<double> w = weights();
+        bool weighted = regressionType == WEIGHTED;
+
+        if(solver == CHOLESKY) {
+            MatrixD A = weighted ? scaleRows(X, w) : X, b = weighted ? scaleRows(y, w) : y;
+            MatrixD gram = Gemm::multiply(A, true, A, false);
+
+            for(size_t j = 1; j < d; j++)
+                gram(j, j) += ridge;
+
+            coefs = Cholesky(gram).solve(Gemm::multiply(A, true, b, false));
+        } else {
+            // the penalty is the same as d - 1 extra elements, sqrt(lambda) e_j with label 0
+            size_t extra = ridge > 0 ? d - 1 : 0;
+            MatrixD A = MatrixD::zeros(n + extra, d), b = MatrixD::zeros(n + extra, y.nCols());
+            double *a = Gemm::data(A), *bd = Gemm::data(b);
+            const double *x = Gemm::data(X), *yd = Gemm::data(y);
+
+            for(size_t i = 0; i < n; i++) {
+                double root = sqrt(w[i]);
+
+                for(size_t j = 0; j < d; j++)
+                    a[i * d + j] = root * x[i * d + j];
+
+                for(size_t j = 0; j < y.nCols(); j++)
+                    bd[i * y.nCols() + j] = root * yd[i * y.nCols() + j];
+            }
+
+            for(size_t j = 1; j <= extra; j++)
+                A(n + j - 1, j) = sqrt(ridge);
+
+            coefs = QR(A).solve(b);
+        }
+
+        // sum of squared residuals, (y - XB)'(y - XB), without materializing y - XB
+        double sse = expr::sum(expr::apply([](double r) { return r * r; },
+            expr::lazy(y) - expr::lazy(Gemm::multiply(X, coefs))));
+        residuals = MatrixD(1, 1, vector<double>(1, sse));
     }
 
     MatrixD predict(MatrixD m) {
         m.addColumn(MatrixD::ones(m.nRows(), 1), 0);
-        return m * coefs;
+        return Gemm::multiply(m, coefs);
     }
 
     const MatrixD &getCoefs() const {
@@ -8,11 +8,16 @@
 #define MACHINE_LEARNING_MLP_HPP
 
 #include <vector>
+#include <numeric>
+#include <functional>
+#include <algorithm>
 #include <chrono>
 #include <iostream>
 #include "../include/matrix/Matrix.hpp"
 #include "../include/mersenne_twister/MersenneTwister.hpp"
 #include "Timer.hpp"
+#include "Gemm.hpp"
+#include "Workspace.hpp"
 
 using namespace std;
 using myClock = chrono::high_resolution_clock;
@@ -24,7 +29,11 @@ using myClock = chrono::high_resolution_clock;
 class MLP {
 private:
     MatrixD data, dataMean, dataDev, classes, originalClasses;
-    vector<MatrixD> W;
+    // weights (inputs x outputs) and biases (1 x outputs) of each layer
+    vector<MatrixD> W, biases;
+    // buffers used by the training iterations, kept between calls to fit()
+    Workspace<double> workspace;
+    unsigned long long trainingAllocations;
 
     // region Activation functions
 
@@ -106,6 +115,42 @@ private:
         return result;
     }
 
+    // ! Takes from the workspace every buffer used by a training iteration, sized for the current weights. When
+    // ! the batch is the whole data set, the data and the classes are used in place
+    // ! @param batch number of elements in each batch
+    // ! @param inputs receives the batch x inputs input of each layer
+    // ! @param derivatives receives the batch x outputs activation derivatives of all but the last layer
+    // ! @param deltas receives the batch x outputs error signals of each layer
+    // ! @param batchClasses receives the one-hot classes of the batch
+    void planWorkspace(size_t batch, vector<double *> &inputs, vector<double *> &derivatives,
+        vector<double *> &deltas, double *&batchClasses) {
+        size_t nLayers = W.size(), size = 0;
+        bool sampled = batch < data.nRows();
+
+        for(size_t i = 0; i < nLayers; i++) {
+            if(i > 0 or sampled)
+                size += Workspace<double>::footprint(batch * W[i].nRows());
+
+            if(i < nLayers - 1)
+                size += Workspace<double>::footprint(batch * W[i].nCols());
+
+            size += Workspace<double>::footprint(batch * W[i].nCols());
+        }
+
+        if(sampled)
+            size += Workspace<double>::footprint(batch * classes.nCols());
+
+        workspace.reserve(size);
+
+        for(size_t i = 0; i < nLayers; i++) {
+            inputs[i] = i > 0 or sampled ? workspace.take(batch * W[i].nRows()) : Gemm::data(data);
+            derivatives[i] = i < nLayers - 1 ? workspace.take(batch * W[i].nCols()) : nullptr;
+            deltas[i] = workspace.take(batch * W[i].nCols());
+        }
+
+        batchClasses = sampled ? workspace.take(batch * classes.nCols()) : Gemm::data(classes);
+    }
+
     static MatrixD binarize(MatrixD m) {
         for(size_t i = 0; i < m.nRows(); i++) {
             size_t largest = 0;
@@ -160,7 +205,7 @@ public:
     enum WeightInitialization { NORMAL, UNIFORM, GLOROT };
     enum OutputFormat { ACTIVATION, SOFTMAX, ONEHOT, SUMMARY };
 
-    MLP() {}
+    MLP() : trainingAllocations(0) {}
 
     // ! Train a multiplayer perceptron
     // ! @param X Input data, with rows representing examples and columns representing features
@@ -279,7 +324,15 @@ public:
             }
         }
 
-        W = hiddenLayers;
+        // the first row of each weight matrix holds the biases of the layer
+        W = vector<MatrixD>(hiddenLayers.size());
+        biases = vector<MatrixD>(hiddenLayers.size());
+
+        for(size_t i = 0; i < hiddenLayers.size(); i++) {
+            MatrixViewD layer(hiddenLayers[i]);
+            biases[i] = layer.rows(0, 1).copy();
+            W[i] = layer.rows(1, layer.nRows() - 1).copy();
+        }
 
         // number of layers. even if there are no hidden layers,
         // there will exist at least one layer of weights that will need to be fitted
@@ -305,107 +358,121 @@ public:
             activationDerivative = tanhDerivative;
         }
 
+        size_t n = data.nRows(), nFeatures = data.nCols();
+        size_t batch = batchSize > 0 and batchSize < n ? batchSize : n;
+
+        // inputs, activation derivatives of all but the last layer and error signals of each layer, all
+        // batch x (layer size)
+        vector<double *> inputs(nLayers), derivatives(nLayers), deltas(nLayers);
+        double *batchClasses;
+        planWorkspace(batch, inputs, derivatives, deltas, batchClasses);
+
+        // order of the elements, whose first positions hold the current batch
+        vector<size_t> order(batch < n ? n : 0);
+        iota(order.begin(), order.end(), 0);
+        MersenneTwister twister;
+
         float lastStdout = 0;
         double previousLoss;
+        unsigned long long warmAllocations = WorkspaceCounter::allocations();
         Timer timer(1, maxIters);
         timer.start();
 
         // training iterations
         for(int iter = 0; iter < maxIters; iter++) {
-            chrono::time_point<chrono::system_clock> iterStart = myClock::now();
-
-            // matrices used in forward pass
-            // Z holds the outputs of each layer
-            vector<MatrixD> Z(nLayers);
-
-            // F are activation derivatives, they are needed for all but the last layer
-            vector<MatrixD> F(nLayers - 1);
-
-            // matrices used on backpropagation
-            // D contains the loss signals for each layer
-            vector<MatrixD> D(nLayers);
-
-            Matrix<int> filter;
-
-            MatrixD currentInput;
-
-            if(batchSize > 0) {
-                MersenneTwister t;
-                MatrixI indices(batchSize, 1, t.randomValues(0, data.nRows(), batchSize, false));
-
-                filter = MatrixI::zeros(data.nRows(), 1);
-
-                for(size_t i = 0; i < indices.nRows(); i++) {
-                    filter(indices(i, 0), 0) = 1;
+            if(batch < n) {
+                // a partial Fisher-Yates shuffle draws the elements of the batch without replacement
+                for(size_t r = 0; r < batch; r++) {
+                    swap(order[r], order[r + twister.i_random(0, static_cast<int>(n - r - 1))]);
+                    const double *element = Gemm::data(data) + order[r] * nFeatures;
+                    const double *target = Gemm::data(classes) + order[r] * outputEncodingSize;
+
+                    copy(element, element + nFeatures, inputs[0] + r * nFeatures);
+                    copy(target, target + outputEncodingSize, batchClasses + r * outputEncodingSize);
                 }
-
-                currentInput = data.getRows(filter);
-            } else
-                currentInput = data;
-
-            // forward pass
-            for(int i = 0; i < nLayers; i++) {
-                // add the bias column to the input of the current layer
-                currentInput.addColumn(MatrixD::ones(currentInput.nRows(), 1), 0);
-
-                MatrixD S = currentInput * W[i]; // multiply input by weights
-
-                // calculate derivatives
-                if(i < nLayers - 1) // derivative of the last layer is not used, so no need to do it
-                    F[i] = S.apply(activationDerivative).transpose();
-
-                // apply activation function, whose resulting matrix will be the next input
-                currentInput = Z[i] = S.apply(activationFunction);
             }
 
-            // backpropagation
-            // last layer error signal
-            MatrixD batchClasses = filter.isEmpty() ? classes : classes.getRows(filter);
-            D[nLayers - 1] = (Z[nLayers - 1] - batchClasses).transpose();
+            // forward pass. Biases and activation functions are applied by the epilogue of the product of the input
+            // by the weights, to each element as soon as it is computed
+            for(size_t i = 0; i < nLayers; i++) {
+                size_t nIn = W[i].nRows(), nOut = W[i].nCols();
+                const double *bias = Gemm::data(biases[i]);
+
+                if(i == nLayers - 1) {
+                    // last layer error signal
+                    Gemm::gemm<double>(batch, nOut, nIn, 1, inputs[i], nIn, 1, Gemm::data(W[i]), nOut, 1, 0,
+                                       deltas[i], nOut, [&](size_t r, size_t j, double &s) {
+                            s = activationFunction(s + bias[j]) - batchClasses[r * nOut + j];
+                        });
+                } else {
+                    // the activations become the next input and the derivatives, needed for all but the last
+                    // layer, are kept for backpropagation
+                    double *next = inputs[i + 1];
+
+                    Gemm::gemm<double>(batch, nOut, nIn, 1, inputs[i], nIn, 1, Gemm::data(W[i]), nOut, 1, 0,
+                                       derivatives[i], nOut, [&](size_t r, size_t j, double &s) {
+                            double x = s + bias[j];
+                            next[r * nOut + j] = activationFunction(x);
+                            s = activationDerivative(x);
+                        });
+                }
+            }
 
             // calculate loss
-            double loss = (D[nLayers - 1]).apply(pow2).sum() / (2 * batchClasses.nRows());
+            double loss = 0, squaredWeights = 0;
 
-            double regularizationTerm = 0;
+            for(size_t e = 0; e < batch * outputEncodingSize; e++)
+                loss += pow2(deltas[nLayers - 1][e]);
 
-            for(auto w : W)
-                regularizationTerm += w.apply(pow2).sum();
+            loss /= 2 * batch;
 
-            regularizationTerm = regularization > 0 ? regularization / (2 * batchClasses.nRows()) : 0;
+            for(size_t i = 0; regularization > 0 and i < nLayers; i++) {
+                for(size_t e = 0; e < W[i].nRows() * W[i].nCols(); e++)
+                    squaredWeights += pow2(Gemm::data(W[i])[e]);
 
-            loss += regularizationTerm;
+                for(size_t j = 0; j < biases[i].nCols(); j++)
+                    squaredWeights += pow2(biases[i](0, j));
+            }
+
+            loss += regularization * squaredWeights / (2 * batch);
 
             // error signals for the intermediate layers
-            for(int i = nLayers - 2; i >= 0; i--) {
-                MatrixD W_noBias = W[i + 1].transpose();
-                W_noBias.removeColumn(0);
-                W_noBias = W_noBias.transpose();
-                // mxb  mxb            mxn       nxb
-                D[i] = F[i].hadamard(W_noBias * D[i + 1]);
+            for(size_t i = nLayers - 1; i-- > 0;) {
+                size_t nOut = W[i].nCols(), nNext = W[i + 1].nCols();
+                const double *derivative = derivatives[i];
+
+                // D[i] = F[i] o (D[i + 1] W[i + 1]'), where the transpose is read in place
+                Gemm::gemm<double>(batch, nOut, nNext, 1, deltas[i + 1], nNext, 1, Gemm::data(W[i + 1]), 1, nNext, 0,
+                                   deltas[i], nOut, [&](size_t r, size_t j, double &d) {
+                        d *= derivative[r * nOut + j];
+                    });
             }
 
             // learning rate is linearly scaled down with passing iterations
             double lr = adaptiveLR ? (learningRate / maxIters) * (maxIters - iter) : learningRate;
+            double decay = 1 - ((learningRate * regularization) / batch);
 
-            // weight updates
+            // weight updates, W[i] = decay * W[i] - lr * input' D[i], accumulated by the GEMM into the weights.
+            // The gradient of the biases is the sum of the error signals over the batch
             for(size_t i = 0; i < nLayers; i++) {
-                MatrixD input;
+                size_t nIn = W[i].nRows(), nOut = W[i].nCols();
+                Gemm::gemm<double>(nIn, nOut, batch, -lr, inputs[i], 1, nIn, deltas[i], nOut, 1, decay,
+                                   Gemm::data(W[i]), nOut);
 
-                if(i == 0)
-                    if(filter.isEmpty())
-                        input = data;
-                    else
-                        input = data.getRows(filter);
+                double *bias = Gemm::data(biases[i]);
 
-                else
-                    input = Z[i - 1];
+                for(size_t j = 0; j < nOut; j++)
+                    bias[j] *= decay;
 
-                input.addColumn(MatrixD::ones(input.nRows(), 1), 0); // add the bias once again
-                MatrixD dW = -lr * (D[i] * input).transpose();
-                // W[i] += dW;
-                W[i] = (1 - ((learningRate * regularization) / batchClasses.nRows())) * W[i] + dW;
+                for(size_t r = 0; r < batch; r++)
+                    for(size_t j = 0; j < nOut; j++)
+                        bias[j] -= lr * deltas[i][r * nOut + j];
             }
 
+            // the first iteration sizes the packing buffers of the matrix products
+            if(iter == 0)
+                warmAllocations = WorkspaceCounter::allocations();
+
             if(verbose and timer.activate(iter)) {
                 char errorChar = (loss == previousLoss or iter == 0) ? '=' : loss > previousLoss ? '+' : '-';
                 cout << "loss: " << loss << ' ' << errorChar << endl;
@@ -417,29 +484,47 @@ public:
             previousLoss = loss;
         }
 
+        trainingAllocations = WorkspaceCounter::allocations() - warmAllocations;
+
         if(verbose)
             cout << "Total training time: " << timer.runningTime() << endl;
     }
 
+    // ! \return number of times the training iterations of the last call to fit() allocated buffers, not counting the
+    // ! first iteration, which sizes the packing buffers of the matrix products. Zero means the training loop did
+    // ! not touch the heap
+    unsigned long long getTrainingAllocations() const {
+        return trainingAllocations;
+    }
+
     // ! Predict the classes of a data set
-    // ! @param X Input data to be classified
+    // ! @param X Input data to be classified, either a Matrix or a view of one
     // ! @param of output format of the method
     // ! @return a matrix, each row containing the output of the network for an example of X
-    MatrixD predict(MatrixD X, OutputFormat of = ACTIVATION) {
-        if(!dataMean.isEmpty() && !dataDev.isEmpty())
-            X = X.standardize(dataMean, dataDev);
-
+    MatrixD predict(MatrixViewD X, OutputFormat of = ACTIVATION) {
         // even when there are no hidden layers, there
         // must be at least one of each of the following
-        size_t nLayers = W.size();
-
-        MatrixD currentInput = X;
-
-        for(int i = 0; i < nLayers; i++) {
-            // add the bias column to the input of the current layer
-            currentInput.addColumn(MatrixD::ones(currentInput.nRows(), 1), 0);
-            MatrixD S = currentInput * W[i];
-            currentInput = S.apply(sigmoid);
+        size_t nLayers = W.size(), n = X.nRows();
+
+        // unstandardized data is read in place
+        MatrixD standardized = !dataMean.isEmpty() && !dataDev.isEmpty() ? X.standardize(dataMean, dataDev) : MatrixD();
+        MatrixViewD input = standardized.isEmpty() ? X : MatrixViewD(standardized);
+        MatrixD currentInput;
+
+        for(size_t i = 0; i < nLayers; i++) {
+            size_t nOut = W[i].nCols();
+            const double *bias = Gemm::data(biases[i]);
+            MatrixD output(n, nOut);
+
+            // the bias and the activation function are applied by the epilogue of the product
+            Gemm::gemm<double>(n, nOut, W[i].nRows(), 1, input.data(), input.rowStride(), input.colStride(),
+                               Gemm::data(W[i]), nOut, 1, 0, Gemm::data(output), nOut,
+                               [&](size_t, size_t j, double &s) {
+                    s = sigmoid(s + bias[j]);
+                });
+
+            currentInput = std::move(output);
+            input = MatrixViewD(currentInput);
         }
 
         if(of == SOFTMAX)
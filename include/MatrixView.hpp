@@ -0,0 +1,322 @@
+/**
+ * @author Douglas De Rizzo Meneghetti (douglasrizzom@gmail.com)
+ * @brief  Non-owning, strided view over the elements of a Matrix
+ * @date   2026-10-16
+ */
+
+#ifndef MACHINE_LEARNING_MATRIXVIEW_HPP
+#define MACHINE_LEARNING_MATRIXVIEW_HPP
+
+#include <vector>
+#include <set>
+#include <cmath>
+#include <stdexcept>
+#include <string>
+#include <cstdint>
+#include <algorithm>
+#include <omp.h>
+#include "../include/matrix/Matrix.hpp"
+
+using namespace std;
+
+
+/**
+ * Read-only view over a matrix, stored elsewhere, that does not own its elements.
+ *
+ * Element (i, j) is located at <code>data[i * rowStride + j * colStride]</code>, so rows, columns, blocks and
+ * transposes of a view are themselves views and cost nothing to create. A view is only valid while the matrix it
+ * refers to is alive and is not resized.
+ * @tparam T The arithmetic type of the viewed elements
+ */
+template<typename T>
+class MatrixView {
+private:
+    // number of rows reduced together by groupSums(), which fixes the order of its additions
+    enum { GROUP_CHUNK = 4096 };
+
+    const T *mData;
+    size_t mRows, mCols, mRowStride, mColStride;
+
+    void validateIndexes(size_t row, size_t col) const {
+        if(row >= mRows)
+            throw invalid_argument(
+                "Invalid row index (" + to_string(row) + "): should be between 0 and " + to_string(mRows - 1));
+
+        if(col >= mCols)
+            throw invalid_argument(
+                "Invalid column index (" + to_string(col) + "): should be between 0 and " + to_string(mCols - 1));
+    }
+
+public:
+
+    // ! Initializes an empty view
+    MatrixView() : mData(nullptr), mRows(0), mCols(0), mRowStride(0), mColStride(0) {}
+
+    // ! Initializes a view over arbitrary strided memory
+    // ! \param data pointer to element (0, 0)
+    // ! \param rows number of rows
+    // ! \param cols number of columns
+    // ! \param rowStride distance, in elements, between two consecutive rows
+    // ! \param colStride distance, in elements, between two consecutive columns
+    MatrixView(const T *data, size_t rows, size_t cols, size_t rowStride, size_t colStride) :
+        mData(data), mRows(rows), mCols(cols), mRowStride(rowStride), mColStride(colStride) {}
+
+    // ! Views all elements of a matrix. Matrix keeps its elements in a single row-major vector,
+    // ! so the address of its first element reaches all of them
+    // ! \param m the viewed matrix
+    MatrixView(const Matrix<T> &m) :
+        mData(m.nRows() * m.nCols() == 0 ? nullptr : &const_cast<Matrix<T> &>(m)(0, 0)),
+        mRows(m.nRows()), mCols(m.nCols()), mRowStride(m.nCols()), mColStride(1) {}
+
+    size_t nRows() const { return mRows; }
+
+    size_t nCols() const { return mCols; }
+
+    size_t rowStride() const { return mRowStride; }
+
+    size_t colStride() const { return mColStride; }
+
+    // ! \return pointer to element (0, 0)
+    const T *data() const { return mData; }
+
+    bool isEmpty() const {
+        return mRows == 0 or mCols == 0;
+    }
+
+    // ! \return whether the elements of each row are adjacent in memory
+    bool hasContiguousRows() const {
+        return mColStride == 1 or mCols <= 1;
+    }
+
+    // ! Unchecked element access
+    T operator()(size_t i, size_t j) const {
+        return mData[i * mRowStride + j * mColStride];
+    }
+
+    // ! Element access with bounds checking
+    T at(size_t i, size_t j) const {
+        validateIndexes(i, j);
+        return operator()(i, j);
+    }
+
+    // ! \return pointer to the first element of row i
+    const T *rowPtr(size_t i) const {
+        return mData + i * mRowStride;
+    }
+
+    // ! \return a view of row i, as a 1 x n matrix
+    MatrixView row(size_t i) const {
+        validateIndexes(i, 0);
+        return MatrixView(rowPtr(i), 1, mCols, mRowStride, mColStride);
+    }
+
+    // ! \return a view of column j, as an n x 1 matrix
+    MatrixView col(size_t j) const {
+        validateIndexes(0, j);
+        return MatrixView(mData + j * mColStride, mRows, 1, mRowStride, mColStride);
+    }
+
+    // ! \return a view of <code>count</code> consecutive rows, starting at row <code>begin</code>
+    MatrixView rows(size_t begin, size_t count) const {
+        if(begin + count > mRows)
+            throw invalid_argument("Row range [" + to_string(begin) + ", " + to_string(begin + count)
+                + ") exceeds the number of rows (" + to_string(mRows) + ")");
+
+        return MatrixView(rowPtr(begin), count, mCols, mRowStride, mColStride);
+    }
+
+    // ! \return a view of <code>count</code> consecutive columns, starting at column <code>begin</code>
+    MatrixView cols(size_t begin, size_t count) const {
+        if(begin + count > mCols)
+            throw invalid_argument("Column range [" + to_string(begin) + ", " + to_string(begin + count)
+                + ") exceeds the number of columns (" + to_string(mCols) + ")");
+
+        return MatrixView(mData + begin * mColStride, mRows, count, mRowStride, mColStride);
+    }
+
+    // ! \return a view of the block with <code>rows</code> x <code>cols</code> elements starting at (row, col)
+    MatrixView block(size_t row, size_t col, size_t rows, size_t cols) const {
+        return this->rows(row, rows).cols(col, cols);
+    }
+
+    // ! \return the transpose of this view, which only swaps its strides
+    MatrixView transpose() const {
+        return MatrixView(mData, mCols, mRows, mColStride, mRowStride);
+    }
+
+    // ! Copies the viewed elements into a new matrix
+    Matrix<T> copy() const {
+        vector<T> elements(mRows * mCols);
+
+        #pragma omp parallel for if(mRows * mCols > 65536)
+        for(size_t i = 0; i < mRows; i++)
+            for(size_t j = 0; j < mCols; j++)
+                elements[i * mCols + j] = operator()(i, j);
+
+        return Matrix<T>(mRows, mCols, elements);
+    }
+
+    T sum() const {
+        T s = 0;
+
+        for(size_t i = 0; i < mRows; i++)
+            for(size_t j = 0; j < mCols; j++)
+                s += operator()(i, j);
+
+        return s;
+    }
+
+    T min() const {
+        T m = operator()(0, 0);
+
+        for(size_t i = 0; i < mRows; i++)
+            for(size_t j = 0; j < mCols; j++)
+                m = std::min(m, operator()(i, j));
+
+        return m;
+    }
+
+    T max() const {
+        T m = operator()(0, 0);
+
+        for(size_t i = 0; i < mRows; i++)
+            for(size_t j = 0; j < mCols; j++)
+                m = std::max(m, operator()(i, j));
+
+        return m;
+    }
+
+    // ! \return sorted column vector with the distinct elements of the view
+    Matrix<T> unique() const {
+        set<T> s;
+
+        for(size_t i = 0; i < mRows; i++)
+            for(size_t j = 0; j < mCols; j++)
+                s.insert(operator()(i, j));
+
+        return Matrix<T>(s.size(), 1, vector<T>(s.begin(), s.end()));
+    }
+
+    // ! \return whether the view contains at most two distinct values
+    bool isBinary() const {
+        return unique().nRows() <= 2;
+    }
+
+    // ! \return column vector with the mean of each column
+    Matrix<T> mean() const {
+        Matrix<T> result = Matrix<T>::zeros(mCols, 1);
+
+        for(size_t i = 0; i < mRows; i++)
+            for(size_t j = 0; j < mCols; j++)
+                result(j, 0) += operator()(i, j);
+
+        result /= mRows;
+        return result;
+    }
+
+    // ! \return column vector with the sample variance of each column
+    Matrix<T> var() const {
+        Matrix<T> means = mean(), result = Matrix<T>::zeros(mCols, 1);
+
+        for(size_t i = 0; i < mRows; i++)
+            for(size_t j = 0; j < mCols; j++) {
+                T diff = operator()(i, j) - means(j, 0);
+                result(j, 0) += diff * diff;
+            }
+
+        result /= (mRows - 1);
+        return result;
+    }
+
+    // ! \return column vector with the sample standard deviation of each column
+    Matrix<T> stdev() const {
+        Matrix<T> result = var();
+
+        for(size_t j = 0; j < mCols; j++)
+            result(j, 0) = sqrt(result(j, 0));
+
+        return result;
+    }
+
+    // ! Standardizes each column using the given means and standard deviations
+    // ! \param means column vector with one mean per column
+    // ! \param stds column vector with one standard deviation per column
+    // ! \return a new matrix with the standardized elements
+    Matrix<T> standardize(const Matrix<T> &means, const Matrix<T> &stds) const {
+        if(means.nRows() != mCols or stds.nRows() != mCols)
+            throw invalid_argument("Number of mean and std. dev. values must be equal to the number of features");
+
+        vector<T> elements(mRows * mCols);
+
+        #pragma omp parallel for if(mRows * mCols > 65536)
+        for(size_t i = 0; i < mRows; i++)
+            for(size_t j = 0; j < mCols; j++)
+                elements[i * mCols + j] = (operator()(i, j) - means(j, 0)) / stds(j, 0);
+
+        return Matrix<T>(mRows, mCols, elements);
+    }
+
+    // ! \return a new matrix with each column standardized to mean 0 and standard deviation 1
+    Matrix<T> standardize() const {
+        return standardize(mean(), stdev());
+    }
+
+    // ! \return a new matrix with the mean of each column subtracted from it
+    Matrix<T> minusMean() const {
+        return standardize(mean(), Matrix<T>::ones(mCols, 1));
+    }
+
+    // ! Sums the rows of each group in a single pass over the elements. Rows are summed in chunks of GROUP_CHUNK,
+    // ! each by one thread into its own buffer, and chunks are added to the result in their order. The additions
+    // ! happen in the same order whatever the number of threads, so the sums are identical across thread counts
+    // ! \param labels group of each row, between 0 and nGroups - 1
+    // ! \param nGroups number of groups
+    // ! \param counts receives the number of rows in each group
+    // ! \return nGroups x n matrix with the sum of the rows of each group. Groups without rows sum to zero
+    Matrix<T> groupSums(const vector<uint32_t> &labels, size_t nGroups, vector<size_t> &counts) const {
+        if(labels.size() != mRows)
+            throw invalid_argument("Number of labels must be equal to the number of rows");
+
+        if(mRows > 0 and *max_element(labels.begin(), labels.end()) >= nGroups)
+            throw invalid_argument("Labels must be smaller than the number of groups");
+
+        vector<T> total(nGroups * mCols, 0);
+        counts.assign(nGroups, 0);
+        size_t nChunks = (mRows + GROUP_CHUNK - 1) / GROUP_CHUNK;
+
+        #pragma omp parallel if(mRows * mCols > 65536)
+        {
+            vector<T> sums(nGroups * mCols);
+
+            #pragma omp for ordered schedule(static, 1)
+            for(size_t chunk = 0; chunk < nChunks; chunk++) {
+                size_t end = std::min<size_t>(mRows, (chunk + 1) * GROUP_CHUNK);
+                fill(sums.begin(), sums.end(), 0);
+
+                for(size_t i = chunk * GROUP_CHUNK; i < end; i++) {
+                    T *groupSum = &sums[labels[i] * mCols];
+                    const T *row = rowPtr(i);
+
+                    for(size_t j = 0; j < mCols; j++)
+                        groupSum[j] += row[j * mColStride];
+                }
+
+                #pragma omp ordered
+                {
+                    for(size_t e = 0; e < nGroups * mCols; e++)
+                        total[e] += sums[e];
+
+                    for(size_t i = chunk * GROUP_CHUNK; i < end; i++)
+                        counts[labels[i]]++;
+                }
+            }
+        }
+
+        return Matrix<T>(nGroups, mCols, total);
+    }
+};
+
+typedef MatrixView<double> MatrixViewD;
+typedef MatrixView<int> MatrixViewI;
+
+#endif // MACHINE_LEARNING_MATRIXVIEW_HPP
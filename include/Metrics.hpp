@@ -5,34 +5,160 @@
 #ifndef MACHINE_LEARNING_METRICS_HPP
 #define MACHINE_LEARNING_METRICS_HPP
 
+#include <vector>
+#include <cmath>
+#include <algorithm>
 #include "../include/matrix/Matrix.hpp"
+#include "MatrixView.hpp"
+#include "Gemm.hpp"
 
 
 /**
  * Distance metrics
+ *
+ * Distances between all pairs of rows of two matrices are computed by a blocked engine, parallelized with OpenMP
+ * over blocks of rows. Squared Euclidean distances come from a single GEMM and the norms of the rows, using
+ * ||a - b||² = ||a||² + ||b||² - 2ab. Manhattan, Chebyshev and other Minkowski distances are computed tile by tile,
+ * with each tile of the second matrix packed so that the innermost loop runs over contiguous memory and can be
+ * vectorized. <code>pow</code> is only called for powers other than 1 and 2.
+ *
+ * When only the closest elements are needed, <code>nearest</code> streams over tiles of distances and keeps the k
+ * best candidates of each row, so the full distance matrix is never stored.
  */
 class Metrics {
+private:
+    // number of rows of each operand processed together by the tiled kernels (TILE)
+    // and by the streaming nearest neighbor search (QUERY_TILE x REFERENCE_TILE)
+    enum { TILE = 64, QUERY_TILE = 256, REFERENCE_TILE = 512 };
+
+    // ! accumulates the absolute differences of the Manhattan distance
+    struct ManhattanTerm {
+        double operator()(double acc, double diff) const { return acc + abs(diff); }
+    };
+
+    // ! keeps the largest absolute difference, for the Chebyshev distance
+    struct ChebyshevTerm {
+        double operator()(double acc, double diff) const { return max(acc, abs(diff)); }
+    };
+
+    // ! accumulates the absolute differences raised to p, for any other Minkowski distance
+    struct PowerTerm {
+        double p;
+
+        explicit PowerTerm(double p) : p(p) {}
+
+        double operator()(double acc, double diff) const { return acc + pow(abs(diff), p); }
+    };
+
+    // ! Computes term-wise distances between all rows of a and all rows of b, writing them row-major into out
+    template<typename Term>
+    static void tiledDistances(MatrixViewD a, MatrixViewD b, const Term &term, double *out) {
+        size_t n = a.nRows(), m = b.nRows(), d = a.nCols();
+
+        #pragma omp parallel if(n * m * d > 32768)
+        {
+            // a tile of b, transposed so that each feature of TILE elements is contiguous
+            vector<double> bPacked(d * TILE), acc(TILE);
+
+            #pragma omp for schedule(static)
+            for(size_t i0 = 0; i0 < n; i0 += TILE) {
+                size_t i1 = min<size_t>(i0 + TILE, n);
+
+                for(size_t j0 = 0; j0 < m; j0 += TILE) {
+                    size_t mb = min<size_t>(TILE, m - j0);
+
+                    for(size_t k = 0; k < d; k++)
+                        for(size_t j = 0; j < mb; j++)
+                            bPacked[k * TILE + j] = b(j0 + j, k);
+
+                    for(size_t i = i0; i < i1; i++) {
+                        fill(acc.begin(), acc.begin() + mb, 0.0);
+
+                        for(size_t k = 0; k < d; k++) {
+                            double aik = a(i, k);
+                            const double *bk = &bPacked[k * TILE];
+
+                            for(size_t j = 0; j < mb; j++)
+                                acc[j] = term(acc[j], aik - bk[j]);
+                        }
+
+                        copy(acc.begin(), acc.begin() + mb, out + i * m + j0);
+                    }
+                }
+            }
+        }
+    }
+
+    // ! Computes squared Euclidean distances between all rows of a and all rows of b as
+    // ! ||a||² + ||b||² - 2ab', writing them row-major into out
+    static void squaredEuclideanDistances(MatrixViewD a, MatrixViewD b, const double *aNorms, const double *bNorms,
+        double *out) {
+        size_t n = a.nRows(), m = b.nRows(), d = a.nCols();
+
+        Gemm::gemm<double>(n, m, d, -2,
+            a.data(), a.rowStride(), a.colStride(),
+            b.data(), b.colStride(), b.rowStride(),
+            0, out, m);
+
+        #pragma omp parallel for if(n * m > 65536)
+        for(size_t i = 0; i < n; i++)
+            for(size_t j = 0; j < m; j++)
+                // rounding may turn distances between nearly identical elements slightly negative
+                out[i * m + j] = max(0.0, out[i * m + j] + aNorms[i] + bNorms[j]);
+    }
+
+    // ! Computes the distances between all rows of a and all rows of b, without taking their root,
+    // ! writing them row-major into out. Norms are only used (and required) when p = 2
+    static void blockDistances(MatrixViewD a, MatrixViewD b, double p, const double *aNorms,
+        const double *bNorms, double *out) {
+        if(p == 2)
+            squaredEuclideanDistances(a, b, aNorms, bNorms, out);
+        else if(p == 1)
+            tiledDistances(a, b, ManhattanTerm(), out);
+        else if(isinf(p))
+            tiledDistances(a, b, ChebyshevTerm(), out);
+        else
+            tiledDistances(a, b, PowerTerm(p), out);
+    }
+
+    // ! Takes the p-th root of a distance, the last step of the Minkowski distance
+    static double root(double distance, double p) {
+        return p == 1 or isinf(p) ? distance : p == 2 ? sqrt(distance) : pow(distance, 1 / p);
+    }
 
 public:
 
+    // ! Calculates the squared Euclidean norm of every row of a matrix
+    // ! \param m matrix of elements
+    // ! \return vector containing the squared norm of each row
+    static vector<double> squaredNorms(MatrixViewD m) {
+        vector<double> norms(m.nRows());
+
+        #pragma omp parallel for if(m.nRows() * m.nCols() > 65536)
+        for(size_t i = 0; i < m.nRows(); i++) {
+            double norm = 0;
+
+            for(size_t k = 0; k < m.nCols(); k++)
+                norm += m(i, k) * m(i, k);
+
+            norms[i] = norm;
+        }
+
+        return norms;
+    }
+
     // ! Calculates the Minkowski distances between elements in a matrix. Elements must be located in the matrix rows
     // ! \param m matrix of elements
     // ! \param p the power to be used by the metric
     // ! \param root whether to take the root of the distance. Default is False for the expected behavior
     // ! \return a matrix containing, in its n x m position, the distance between the nth and mth elements in the matrix
-    static MatrixD minkowski(MatrixD m, double p, bool root = true) {
-        MatrixD distances = MatrixD::zeros(m.nRows(), m.nRows());
+    static MatrixD minkowski(MatrixViewD m, double p, bool root = true) {
+        MatrixD distances = minkowski(m, m, p, root);
 
-        for(size_t i = 0; i < m.nRows(); i++) {
-            for(size_t j = i + 1; j < m.nRows(); j++) {
-                for(size_t k = 0; k < m.nCols(); k++) {
-                    distances(i, j) += pow(abs(m(i, k) - m(j, k)), p);
-                }
-
-                if(root)
-                    distances(i, j) = pow(distances(i, j), 1 / p);
-            }
-        }
+        // only distances above the diagonal are kept
+        for(size_t i = 0; i < m.nRows(); i++)
+            for(size_t j = 0; j <= i; j++)
+                distances(i, j) = 0;
 
         return distances;
     }
@@ -40,27 +166,15 @@ public:
     // ! Calculates the Chebyshev distances between elements in a matrix. Elements must be located in the matrix rows
     // ! \param a matrix of elements
     // ! \return a matrix containing, in its n x m position, the distance between the nth and mth elements in the matrix
-    static MatrixD chebyshev(MatrixD a) {
-        MatrixD distances = MatrixD::zeros(a.nRows(), a.nRows());
-
-        for(size_t i = 0; i < a.nRows(); i++) {
-            for(size_t j = i + 1; j < a.nRows(); j++) {
-                for(size_t k = 0; k < a.nCols(); k++) {
-                    double x1 = a(i, k), x2 = a(j, k);
-                    double term = abs(x1 - x2);
-                    distances(i, j) = distances(j, i) = max(distances(i, j), term);
-                }
-            }
-        }
-
-        return distances;
+    static MatrixD chebyshev(MatrixViewD a) {
+        return chebyshev(a, a);
     }
 
     // ! Calculates the Euclidean distances between elements in a matrix. Elements must be located in the matrix rows
     // ! \param m matrix of elements
     // ! \param root whether to take the root of the distance. Default is False for the expected behavior
     // ! \return a matrix containing, in its n x m position, the distance between the nth and mth elements in the matrix
-    static MatrixD euclidean(MatrixD m, bool root = true) {
+    static MatrixD euclidean(MatrixViewD m, bool root = true) {
         return minkowski(m, 2, root);
     }
 
@@ -68,7 +182,7 @@ public:
     // ! \param m matrix of elements
     // ! \param root whether to take the root of the distance. Default is False for the expected behavior
     // ! \return a matrix containing, in its n x m position, the distance between the nth and mth elements in the matrix
-    static MatrixD manhattan(MatrixD m, bool root = true) {
+    static MatrixD manhattan(MatrixViewD m, bool root = true) {
         return minkowski(m, 1, root);
     }
 
@@ -78,50 +192,130 @@ public:
     // ! \param p the power to be used by the metric
     // ! \param root whether to take the root of the distance. Default is False for the expected behavior
     // ! \return a matrix containing, in its n x m position, the distance between the nth element in the first matrix and the mth element in the second matrix
-    static MatrixD minkowski(MatrixD a, MatrixD b, double p, bool root = true) {
+    static MatrixD minkowski(MatrixViewD a, MatrixViewD b, double p, bool root = true) {
         if(a.nCols() != b.nCols())
             throw runtime_error("Matrices have different number of dimensions");
 
-        MatrixD distances = MatrixD::zeros(a.nRows(), b.nRows());
+        size_t n = a.nRows(), m = b.nRows();
+        MatrixD result(n, m);
+        double *out = Gemm::data(result);
+        vector<double> aNorms, bNorms;
 
-        for(size_t i = 0; i < a.nRows(); i++) {
-            for(size_t j = 0; j < b.nRows(); j++) {
-                for(size_t k = 0; k < a.nCols(); k++) {
-                    double x1 = a(i, k), x2 = b(j, k);
-                    double term = pow(abs(x1 - x2), p);
-                    distances(i, j) += term;
-                }
+        if(p == 2) {
+            aNorms = squaredNorms(a);
+            bNorms = squaredNorms(b);
+        }
 
-                if(root)
+        blockDistances(a, b, p, aNorms.data(), bNorms.data(), out);
 
-                    distances(i, j) = pow(distances(i, j), 1 / p);
-            }
+        if(root and p != 1 and !isinf(p)) {
+            #pragma omp parallel for if(n * m > 65536)
+            for(size_t i = 0; i < n; i++)
+                for(size_t j = 0; j < m; j++)
+                    out[i * m + j] = Metrics::root(out[i * m + j], p);
         }
 
-        return distances;
+        return result;
     }
 
     // ! Calculates the Chebyshev distances between elements in two matrices. Elements must be located in the matrices rows and both matrices must have the same number of features (columns)
     // ! \param a first matrix
     // ! \param b second matrix
     // ! \return a matrix containing, in its n x m position, the distance between the nth element in the first matrix and the mth element in the second matrix
-    static MatrixD chebyshev(MatrixD a, MatrixD b) {
+    static MatrixD chebyshev(MatrixViewD a, MatrixViewD b) {
+        if(a.nCols() != b.nCols())
+            throw runtime_error("Matrices have different number of dimensions");
+
+        MatrixD distances(a.nRows(), b.nRows());
+        tiledDistances(a, b, ChebyshevTerm(), Gemm::data(distances));
+        return distances;
+    }
+
+    // ! Finds, for every element in a, the k closest elements in b according to the Minkowski distance.
+    // ! Distances are computed in tiles and only the k best candidates of each element are kept,
+    // ! so memory usage is proportional to the number of elements in a times k.
+    // ! Ties are broken in favor of the element of b with the smallest index
+    // ! \param a matrix of query elements, located in its rows
+    // ! \param b matrix of reference elements, located in its rows
+    // ! \param k number of neighbors to find for each element of a
+    // ! \param p the power to be used by the metric. Use infinity for the Chebyshev distance
+    // ! \param root whether to take the root of the distance
+    // ! \return a pair of n x k matrices. The first contains the indices of the neighbors in b, the second their
+    // ! distances. Each row is sorted from the closest neighbor to the farthest
+    static pair<MatrixI, MatrixD> nearest(MatrixViewD a, MatrixViewD b, size_t k, double p = 2, bool root = true) {
         if(a.nCols() != b.nCols())
             throw runtime_error("Matrices have different number of dimensions");
 
-        MatrixD distances = MatrixD::zeros(a.nRows(), b.nRows());
+        if(k == 0 or k > b.nRows())
+            throw invalid_argument("k must be between 1 and the number of reference elements ("
+                + to_string(b.nRows()) + ")");
+
+        typedef pair<double, size_t> Candidate;
+        size_t n = a.nRows(), m = b.nRows();
+        MatrixI indices(n, k);
+        MatrixD distances(n, k);
+        vector<double> aNorms, bNorms;
+
+        if(p == 2) {
+            aNorms = squaredNorms(a);
+            bNorms = squaredNorms(b);
+        }
+
+        #pragma omp parallel if(n * m > 65536)
+        {
+            // buffers are no larger than the operands, so small searches do not allocate whole tiles
+            vector<double> tile(min<size_t>(n, QUERY_TILE) * min<size_t>(m, REFERENCE_TILE));
+            // one max-heap of candidates per query element, its worst candidate on top
+            vector<Candidate> heaps(min<size_t>(n, QUERY_TILE) * k);
+
+            #pragma omp for schedule(dynamic)
+            for(size_t i0 = 0; i0 < n; i0 += QUERY_TILE) {
+                size_t na = min<size_t>(QUERY_TILE, n - i0);
+                MatrixViewD aTile = a.rows(i0, na);
+                size_t filled = 0;
 
-        for(size_t i = 0; i < a.nRows(); i++) {
-            for(size_t j = 0; j < b.nRows(); j++) {
-                for(size_t k = 0; k < a.nCols(); k++) {
-                    double x1 = a(i, k), x2 = b(j, k);
-                    double term = abs(x1 - x2);
-                    distances(i, j) = max(distances(i, j), term);
+                for(size_t j0 = 0; j0 < m; j0 += REFERENCE_TILE) {
+                    size_t nb = min<size_t>(REFERENCE_TILE, m - j0);
+                    blockDistances(aTile, b.rows(j0, nb), p, aNorms.data() + (p == 2 ? i0 : 0),
+                        bNorms.data() + (p == 2 ? j0 : 0), tile.data());
+
+                    for(size_t i = 0; i < na; i++) {
+                        Candidate *heap = &heaps[i * k];
+                        const double *row = &tile[i * nb];
+                        size_t size = filled, j = 0;
+
+                        // the first k reference elements fill the heap
+                        for(; size < k and j < nb; j++, size++) {
+                            heap[size] = Candidate(row[j], j0 + j);
+                            push_heap(heap, heap + size + 1);
+                        }
+
+                        // after that, a candidate only enters the heap if it beats the worst one
+                        for(; j < nb; j++) {
+                            if(row[j] < heap[0].first) {
+                                pop_heap(heap, heap + k);
+                                heap[k - 1] = Candidate(row[j], j0 + j);
+                                push_heap(heap, heap + k);
+                            }
+                        }
+                    }
+
+                    filled = min<size_t>(k, filled + nb);
+                }
+
+                for(size_t i = 0; i < na; i++) {
+                    Candidate *heap = &heaps[i * k];
+                    sort_heap(heap, heap + k);
+
+                    for(size_t c = 0; c < k; c++) {
+                        indices(i0 + i, c) = static_cast<int>(heap[c].second);
+                        distances(i0 + i, c) = root ? Metrics::root(heap[c].first, p) : heap[c].first;
+                    }
                 }
             }
         }
 
-        return distances;
+        return make_pair(indices, distances);
     }
 
     // ! Calculates the Euclidean distances between elements in two matrices. Elements must be located in the matrices rows and both matrices must have the same number of features (columns)
@@ -129,7 +323,7 @@ public:
     // ! \param b second matrix
     // ! \param root whether to take the root of the distance. Default is False for the expected behavior
     // ! \return a matrix containing, in its n x m position, the distance between the nth element in the first matrix and the mth element in the second matrix
-    static MatrixD euclidean(MatrixD a, MatrixD b, bool root = true) {
+    static MatrixD euclidean(MatrixViewD a, MatrixViewD b, bool root = true) {
         return minkowski(a, b, 2, root);
     }
 
@@ -138,7 +332,7 @@ public:
     // ! \param b second matrix
     // ! \param root whether to take the root of the distance. Default is False for the expected behavior
     // ! \return a matrix containing, in its n x m position, the distance between the nth element in the first matrix and the mth element in the second matrix
-    static MatrixD manhattan(MatrixD a, MatrixD b, bool root = true) {
+    static MatrixD manhattan(MatrixViewD a, MatrixViewD b, bool root = true) {
         return minkowski(a, b, 1, root);
     }
 };
@@ -0,0 +1,246 @@
+/**
+ * @author Douglas De Rizzo Meneghetti (douglasrizzom@gmail.com)
+ * @brief  Mini-batch k-means, for data sets that do not fit in memory and for data streams
+ * @date   2026-10-16
+ */
+
+#ifndef MACHINE_LEARNING_MINIBATCHKMEANS_HPP
+#define MACHINE_LEARNING_MINIBATCHKMEANS_HPP
+
+#include <vector>
+#include <random>
+#include <chrono>
+#include <limits>
+#include <stdexcept>
+#include <cstdint>
+#include "../include/matrix/Matrix.hpp"
+#include "MatrixView.hpp"
+#include "Metrics.hpp"
+#include "Gemm.hpp"
+#include "BatchReader.hpp"
+
+using namespace std;
+
+
+/**
+ * Mini-batch k-means (Sculley, 2010), using the Euclidean distance.
+ *
+ * Instead of assigning every element of the data set before each centroid update, centroids are updated after
+ * each batch of elements. Each centroid keeps the number of elements assigned to it so far and moves towards a new
+ * element with learning rate 1 / count, so it is always the mean of every element ever assigned to it. Memory is
+ * bounded by the size of a batch, so the data set can be read from a file in chunks by fitStream() or arrive as
+ * a stream through partialFit().
+ *
+ * Features are standardized with the means and standard deviations of the first batch, which must contain at
+ * least k elements. Those statistics are then applied to every batch and to predict(), keeping all elements in
+ * the same space as the centroids.
+ */
+class MiniBatchKMeans {
+private:
+    unsigned int k;
+    size_t batchSize;
+    MatrixD centroids, means, stds;
+    // number of elements assigned to each centroid so far
+    vector<unsigned long long> counts;
+    // sum of squared distances between the elements of the last batch and their centroids
+    double batchSSE;
+    unsigned long long seenElements;
+    mt19937_64 generator;
+
+    // ! k-means++ initialization over the first batch
+    void initialize(const MatrixD &batch) {
+        size_t n = batch.nRows(), d = batch.nCols();
+        const double *x = Gemm::data(batch);
+        vector<double> minDistances(n, numeric_limits<double>::infinity());
+        vector<double> elements(k * d);
+
+        for(size_t c = 0; c < k; c++) {
+            size_t pick = n - 1;
+
+            if(c == 0)
+                pick = uniform_int_distribution<size_t>(0, n - 1)(generator);
+            else {
+                double total = 0, cumulative = 0;
+
+                for(size_t i = 0; i < n; i++)
+                    total += minDistances[i];
+
+                double target = uniform_real_distribution<double>(0, total)(generator);
+
+                for(size_t i = 0; i < n; i++) {
+                    cumulative += minDistances[i];
+
+                    if(cumulative > target) {
+                        pick = i;
+                        break;
+                    }
+                }
+            }
+
+            copy(x + pick * d, x + (pick + 1) * d, elements.begin() + c * d);
+
+            for(size_t i = 0; i < n; i++) {
+                double dist = 0;
+
+                for(size_t j = 0; j < d; j++)
+                    dist += (x[i * d + j] - x[pick * d + j]) * (x[i * d + j] - x[pick * d + j]);
+
+                minDistances[i] = min(minDistances[i], dist);
+            }
+        }
+
+        centroids = MatrixD(k, d, elements);
+        counts.assign(k, 0);
+    }
+
+    // ! Standardizes a batch with the statistics of the first batch, which are computed if none was seen yet
+    MatrixD standardize(MatrixViewD batch) {
+        if(means.isEmpty()) {
+            means = batch.mean();
+            stds = batch.stdev();
+
+            // constant features are only centered
+            for(size_t j = 0; j < stds.nRows(); j++)
+                if(stds(j, 0) == 0 or stds(j, 0) != stds(j, 0))
+                    stds(j, 0) = 1;
+        }
+
+        if(batch.nCols() != means.nRows())
+            throw invalid_argument("Batch has " + to_string(batch.nCols()) + " features, but the model was fit on "
+                                   + to_string(means.nRows()));
+
+        return batch.standardize(means, stds);
+    }
+
+public:
+
+    // ! \param k number of clusters
+    // ! \param batchSize number of elements read at a time by fit()
+    explicit MiniBatchKMeans(unsigned int k, size_t batchSize = 1024) :
+        k(k), batchSize(batchSize), batchSSE(0), seenElements(0),
+        generator(static_cast<unsigned long long>(chrono::high_resolution_clock::now().time_since_epoch().count())) {
+        if(k == 0 or batchSize == 0)
+            throw invalid_argument("Number of clusters and batch size must be positive");
+    }
+
+    // ! Sets the seed of the random number generator used to choose the initial centroids
+    void setSeed(unsigned long long seed) {
+        generator.seed(seed);
+    }
+
+    // ! Updates the centroids with one batch of elements. Can be called repeatedly as data arrives
+    // ! \param data a batch of elements in rows, with features in columns
+    void partialFit(MatrixViewD data) {
+        if(data.isEmpty())
+            return;
+
+        bool first = centroids.isEmpty();
+
+        if(first and data.nRows() < k)
+            throw invalid_argument("The first batch must have at least as many elements as clusters");
+
+        MatrixD batch = standardize(data);
+
+        if(first)
+            initialize(batch);
+
+        size_t n = batch.nRows(), d = batch.nCols();
+        pair<MatrixI, MatrixD> closest = Metrics::nearest(batch, centroids, 1, 2, false);
+        vector<uint32_t> labels(n);
+        batchSSE = 0;
+
+        for(size_t i = 0; i < n; i++) {
+            labels[i] = static_cast<uint32_t>(closest.first(i, 0));
+            batchSSE += closest.second(i, 0);
+        }
+
+        // elements of the batch are summed per centroid and then merged into the running means, which gives the
+        // same centroids as moving them one element at a time with learning rate 1 / count
+        vector<size_t> batchCounts;
+        MatrixD sumMatrix = MatrixViewD(batch).groupSums(labels, k, batchCounts);
+        const double *sums = Gemm::data(sumMatrix);
+
+        double *cData = Gemm::data(centroids);
+
+        for(size_t c = 0; c < k; c++) {
+            if(batchCounts[c] == 0)
+                continue;
+
+            counts[c] += batchCounts[c];
+            double learningRate = 1.0 / counts[c];
+
+            for(size_t j = 0; j < d; j++)
+                cData[c * d + j] += learningRate * (sums[c * d + j] - batchCounts[c] * cData[c * d + j]);
+        }
+
+        seenElements += n;
+    }
+
+    // ! Fits the model to a data set read in batches, such as a file larger than the available memory
+    // ! \param source a CSVBatchReader, a MatrixBatchReader or any object with the same next() and rewind() methods
+    // ! \param epochs number of passes over the data set
+    template<typename Source>
+    void fitStream(Source &source, unsigned int epochs = 1) {
+        MatrixD batch;
+
+        for(unsigned int epoch = 0; epoch < epochs; epoch++) {
+            if(epoch > 0)
+                source.rewind();
+
+            while(source.next(batchSize, batch))
+                partialFit(batch);
+        }
+    }
+
+    // ! Fits the model to a data set in memory, in batches
+    void fit(MatrixViewD data, unsigned int epochs = 1) {
+        MatrixBatchReader reader(data);
+        fitStream(reader, epochs);
+    }
+
+    // ! Assigns elements to the closest centroids
+    // ! \param data elements in rows, with the same features used to fit the model
+    // ! \return column vector with the cluster of each element
+    MatrixD predict(MatrixViewD data) {
+        if(centroids.isEmpty())
+            throw runtime_error("Model has not been fit yet");
+
+        MatrixI closest = Metrics::nearest(standardize(data), centroids, 1, 2, false).first;
+        MatrixD result(data.nRows(), 1);
+
+        for(size_t i = 0; i < data.nRows(); i++)
+            result(i, 0) = closest(i, 0);
+
+        return result;
+    }
+
+    // ! \return centroids, in the standardized feature space
+    const MatrixD &getCentroids() const {
+        return centroids;
+    }
+
+    // ! \return number of elements assigned to each centroid so far
+    const vector<unsigned long long> &getCounts() const {
+        return counts;
+    }
+
+    // ! \return sum of squared distances between the elements of the last batch and their centroids
+    double getBatchSSE() const {
+        return batchSSE;
+    }
+
+    unsigned long long getSeenElements() const {
+        return seenElements;
+    }
+
+    unsigned int getK() const {
+        return k;
+    }
+
+    size_t getBatchSize() const {
+        return batchSize;
+    }
+};
+
+
+#endif // MACHINE_LEARNING_MINIBATCHKMEANS_HPP
@@ -8,7 +8,12 @@
 #ifndef MACHINE_LEARNING_PCA_HPP
 #define MACHINE_LEARNING_PCA_HPP
 
+#include <random>
+#include <algorithm>
 #include "../include/matrix/Matrix.hpp"
+#include "MatrixView.hpp"
+#include "Gemm.hpp"
+#include "SymmetricEigen.hpp"
 
 using namespace std;
 
@@ -19,22 +24,81 @@ using namespace std;
 class PCA {
 
 private:
+    // extra random directions sampled beyond the requested components and passes of power iteration used by the
+    // randomized fit
+    enum { OVERSAMPLING = 10, POWER_ITERATIONS = 4 };
+
     MatrixD X, eigenvalues, eigenvectors, percentages, cumPercentages;
+    // mean of each feature (d x 1)
+    MatrixD means;
+    unsigned long long seed;
+
+    // ! Makes the columns of a matrix orthonormal by modified Gram-Schmidt, applied twice so that orthogonality
+    // ! is not lost to rounding. Columns that depend linearly on the previous ones are zeroed
+    static void orthonormalize(MatrixD &m) {
+        size_t n = m.nRows(), l = m.nCols();
+        double *a = Gemm::data(m);
+
+        for(size_t j = 0; j < l; j++) {
+            double originalNorm = 0, norm = 0;
+
+            for(size_t r = 0; r < n; r++)
+                originalNorm += a[r * l + j] * a[r * l + j];
+
+            for(int pass = 0; pass < 2; pass++)
+                for(size_t i = 0; i < j; i++) {
+                    double dot = 0;
+
+                    for(size_t r = 0; r < n; r++)
+                        dot += a[r * l + i] * a[r * l + j];
+
+                    for(size_t r = 0; r < n; r++)
+                        a[r * l + j] -= dot * a[r * l + i];
+                }
+
+            for(size_t r = 0; r < n; r++)
+                norm += a[r * l + j] * a[r * l + j];
+
+            double scale = norm > 1e-24 * originalNorm and norm > 0 ? 1 / sqrt(norm) : 0;
+
+            for(size_t r = 0; r < n; r++)
+                a[r * l + j] *= scale;
+        }
+    }
+
+    // ! Centers the data set with the mean of each feature, which is kept to center new data
+    MatrixD center() {
+        means = MatrixViewD(X).mean();
+        return MatrixViewD(X).standardize(means, MatrixD::ones(X.nCols(), 1));
+    }
+
+    // ! Calculates the percentage of the total variance that each eigenvalue explains
+    void computePercentages(double sumVar) {
+        percentages = MatrixD(eigenvalues.nRows(), eigenvalues.nCols());
+        cumPercentages = MatrixD(eigenvalues.nRows(), eigenvalues.nCols());
+
+        for(size_t i = 0; i < eigenvalues.nRows(); i++) {
+            percentages(i, 0) = eigenvalues(i, 0) / sumVar;
+            cumPercentages(i, 0) = i == 0 ? percentages(i, 0) : percentages(i, 0) + cumPercentages(i - 1, 0);
+        }
+    }
+
 public:
 
     /**
      * Principal component analysis algorithm
      * @param data the matrix whose principal components will be found
      */
-    explicit PCA(MatrixD data) {
+    explicit PCA(MatrixD data) : seed(42) {
         X = std::move(data);
     }
 
     /**
-     * Finds the principal components of a Matrix. Eigenvectors and eigenvalues are found via the Jacobi eigenvalue algorithm
+     * Finds the principal components of a Matrix. Eigenvectors and eigenvalues are found by Householder
+     * tridiagonalization followed by the QL algorithm
      */
     void fit() {
-        MatrixD XMinusMean = X.minusMean(); // standardize columns to have 0 mean
+        MatrixD XMinusMean = center(); // standardize columns to have 0 mean
         MatrixD covariances = XMinusMean.cov(); // get covariance matrix of the data
 
         // get the sum of variances, this'll be useful later
@@ -44,38 +108,122 @@ public:
             sumVar += covariances(i, i);
         }
 
-        pair<MatrixD, MatrixD> eig = covariances.eigen(); // eigenvalues and eigenvectors of cov matrix
-        eigenvalues = eig.first;
-        eigenvectors = eig.second;
+        SymmetricEigen eig(covariances); // eigenvalues and eigenvectors of cov matrix
+        eigenvalues = eig.getEigenvalues();
+        eigenvectors = eig.getEigenvectors();
 
         // calculate the percentage of variance that each eigenvalue "explains"
-        percentages = MatrixD(eigenvalues.nRows(), eigenvalues.nCols());
-        cumPercentages = MatrixD(eigenvalues.nRows(), eigenvalues.nCols());
+        computePercentages(sumVar);
+    }
 
-        for(int i = 0; i < eigenvalues.nRows(); i++) {
-            percentages(i, 0) = eigenvalues(i, 0) / sumVar;
-            cumPercentages(i, 0) = i == 0 ? percentages(i, 0) : percentages(i, 0) + cumPercentages(i - 1, 0);
+    /**
+     * Finds only the principal components with the largest eigenvalues, by randomized range finding
+     * (Halko, Martinsson and Tropp, 2011). The centered data set is multiplied by a few random directions and the
+     * result is refined by power iterations, which yields an orthonormal basis of the subspace spanned by the
+     * leading components. The data set is projected onto that basis and the small projected problem is solved
+     * exactly. The covariance matrix is never formed, so time is O(n d numComponents) and memory is
+     * O((n + d) numComponents). Percentages are relative to the total variance of the data set, as in fit()
+     * @param numComponents number of principal components to be found
+     */
+    void fit(size_t numComponents) {
+        MatrixD XMinusMean = center();
+        size_t n = XMinusMean.nRows(), d = XMinusMean.nCols();
+
+        if(numComponents == 0 or numComponents > min(n, d))
+            throw invalid_argument("Number of components must be between 1 and " + to_string(min(n, d)));
+
+        size_t l = min(numComponents + OVERSAMPLING, min(n, d));
+        MatrixViewD centered(XMinusMean);
+
+        // the sum of variances is the sum of the diagonal of the covariance matrix
+        double sumVar = 0;
+        const double *x = Gemm::data(XMinusMean);
+
+        for(size_t i = 0; i < n * d; i++)
+            sumVar += x[i] * x[i];
+
+        sumVar /= n - 1;
+
+        // random directions in feature space
+        mt19937_64 generator(seed);
+        normal_distribution<double> normal;
+        MatrixD omega(d, l);
+
+        for(size_t i = 0; i < d; i++)
+            for(size_t j = 0; j < l; j++)
+                omega(i, j) = normal(generator);
+
+        // orthonormal basis of the range of X * omega, refined by power iterations, which raise the singular values
+        // of X to odd powers so that the leading ones dominate the basis
+        MatrixD Q = Gemm::multiply(centered, MatrixViewD(omega));
+        orthonormalize(Q);
+
+        for(unsigned int iteration = 0; iteration < POWER_ITERATIONS; iteration++) {
+            MatrixD Z = Gemm::multiply(centered.transpose(), MatrixViewD(Q));
+            orthonormalize(Z);
+            Q = Gemm::multiply(centered, MatrixViewD(Z));
+            orthonormalize(Q);
+        }
+
+        // B = Q' X is l x d and has the same leading singular values as X. It is kept transposed, and the
+        // eigenvectors U of B B' give the right singular vectors of B as B' U, scaled by the singular values
+        MatrixD Bt = Gemm::multiply(centered.transpose(), MatrixViewD(Q));
+        SymmetricEigen eig(Gemm::multiply(Bt, true, Bt, false), numComponents);
+        MatrixD V = Gemm::multiply(Bt, eig.getEigenvectors());
+
+        eigenvalues = MatrixD(numComponents, 1);
+        eigenvectors = MatrixD(d, numComponents);
+
+        for(size_t c = 0; c < numComponents; c++) {
+            double squaredSingularValue = max(eig.getEigenvalues()(c, 0), 0.0);
+            double scale = squaredSingularValue > 0 ? 1 / sqrt(squaredSingularValue) : 0;
+            eigenvalues(c, 0) = squaredSingularValue / (n - 1);
+
+            for(size_t i = 0; i < d; i++)
+                eigenvectors(i, c) = V(i, c) * scale;
         }
+
+        computePercentages(sumVar);
+    }
+
+    /**
+     * Projects elements onto the principal components found by <code>fit()</code>. Elements are centered with the
+     * mean of the fitted data set a tile of rows at a time, right before they are multiplied, so the centered data
+     * is never formed whole and no precision is lost when features have a large mean
+     * @param data a Matrix, or a view of one, containing elements in rows and the fitted features in columns
+     * @param numComponents number of components, those with the largest eigenvalues, to project onto. 0 uses all
+     * components that were found
+     * @return n x numComponents matrix with the projected elements
+     */
+    MatrixD transform(MatrixViewD data, size_t numComponents = 0) const {
+        if(eigenvectors.nCols() == 0)
+            throw runtime_error("PCA has not been fit yet");
+
+        if(data.nCols() != means.nRows())
+            throw invalid_argument("Data has " + to_string(data.nCols()) + " features, but PCA was fit on "
+                                   + to_string(means.nRows()));
+
+        size_t found = eigenvectors.nCols();
+        size_t k = numComponents == 0 or numComponents > found ? found : numComponents;
+
+        return Gemm::multiplyShifted(data, Gemm::data(means), MatrixViewD(eigenvectors).cols(0, k));
     }
 
     // ! Rotates the data set, using the eigenvectors of the covariance matrix as the new base
     // ! \return the original dataset rotated using the eigenvectors of the covariance matrix as the new base
-    MatrixD transform() {
-        MatrixD finalData = eigenvectors.transpose() * X.minusMean().transpose();
-        return finalData.transpose();
+    MatrixD transform() const {
+        return transform(X);
     }
 
     // ! Rotates the data set, using the eigenvectors of the covariance matrix with the largest eigenvalues as the new base
     // ! \return the original dataset rotated using the eigenvectors of the covariance matrix with the largest eigenvalues as the new base
-    MatrixD transform(int numComponents) {
-        MatrixI filter = MatrixI::zeros(eigenvalues.nRows(), 1);
-
-        for(int i = 0; i < numComponents; i++) {
-            filter(i, 0) = 1;
-        }
+    MatrixD transform(int numComponents) const {
+        return transform(X, static_cast<size_t>(numComponents));
+    }
 
-        MatrixD finalData = eigenvectors.getColumns(filter).transpose() * X.minusMean().transpose();
-        return finalData.transpose();
+    // ! \return column vector with the mean of each feature of the fitted data set
+    const MatrixD &getMeans() const {
+        return means;
     }
 
     const MatrixD &getEigenvalues() const {
@@ -93,6 +241,15 @@ public:
     const MatrixD &getCumPercentages() const {
         return cumPercentages;
     }
+
+    unsigned long long getSeed() const {
+        return seed;
+    }
+
+    // ! Sets the seed of the random directions used by fit(numComponents)
+    void setSeed(unsigned long long seed) {
+        PCA::seed = seed;
+    }
 };
 
 
@@ -0,0 +1,215 @@
+/**
+ * @author Douglas De Rizzo Meneghetti (douglasrizzom@gmail.com)
+ * @brief  Hamming distance search over categorical data packed into bits
+ * @date   2026-10-16
+ */
+
+#ifndef MACHINE_LEARNING_PACKEDHAMMING_HPP
+#define MACHINE_LEARNING_PACKEDHAMMING_HPP
+
+#include <vector>
+#include <algorithm>
+#include <cstdint>
+#include "SpatialIndex.hpp"
+#include "AlignedAllocator.hpp"
+
+#if (defined(__AVX512F__) && defined(__AVX512VPOPCNTDQ__)) || defined(__AVX2__)
+#include <immintrin.h>
+#endif
+
+using namespace std;
+
+
+/**
+ * Exact Hamming distance search over categorical features, one-hot encoded into 64-bit words.
+ *
+ * Each feature with more than one distinct value gets one bit per value, so two rows that differ in a feature
+ * differ in exactly two of its bits and the Hamming distance between them is half the number of set bits in the
+ * XOR of their words. Query values never seen in the data set set no bit, and features with a single value in the
+ * data set take no bits at all; both are accounted for by a per-query correction.
+ *
+ * Rows are stored in blocks of LANES rows, word by word, so that the same word of all rows in a block is
+ * contiguous and one SIMD instruction computes the XOR and population count of all of them. The kernel is chosen
+ * at compile time: AVX-512 VPOPCNTDQ, AVX2 (population count by nibble lookup) or the scalar popcount builtin.
+ */
+class PackedHammingIndex : public SpatialIndex {
+private:
+    enum { LANES = 8 };
+
+    // sorted distinct values of each feature and the position of the bit of its first value
+    vector<vector<double> > values;
+    vector<size_t> firstBit;
+    size_t nWords;
+    // nBlocks x nWords x LANES words
+    AlignedVector<uint64_t> packed;
+
+    // ! Sets the bits of a row. Values that are not in the data set set no bit
+    // ! \return the correction, in half-units of distance, for features that set no bit
+    size_t pack(const double *row, uint64_t *words, size_t stride) const {
+        size_t correction = 0;
+
+        for(size_t j = 0; j < d; j++) {
+            const vector<double> &featureValues = values[j];
+            size_t v = static_cast<size_t>(lower_bound(featureValues.begin(), featureValues.end(), row[j])
+                                           - featureValues.begin());
+            bool known = v < featureValues.size() and featureValues[v] == row[j];
+
+            if(featureValues.size() == 1)
+                correction += known ? 0 : 2;
+            else if(!known)
+                correction += 1;
+            else {
+                size_t bit = firstBit[j] + v;
+                words[bit / 64 * stride] |= uint64_t(1) << bit % 64;
+            }
+        }
+
+        return correction;
+    }
+
+    // ! \return sorted distinct values of feature j of n rows with d features each
+    static vector<double> distinctValues(const double *points, size_t n, size_t d, size_t j) {
+        vector<double> featureValues(n);
+
+        for(size_t i = 0; i < n; i++)
+            featureValues[i] = points[i * d + j];
+
+        sort(featureValues.begin(), featureValues.end());
+        featureValues.erase(unique(featureValues.begin(), featureValues.end()), featureValues.end());
+        return featureValues;
+    }
+
+    // ! \return the packed query of the calling thread, so concurrent queries do not share it and consecutive ones
+    // ! reuse its memory
+    static vector<uint64_t> &queryWords() {
+        static thread_local vector<uint64_t> words;
+        return words;
+    }
+
+    // ! Population count of a word. Without a popcount instruction, bits are added in parallel within the word,
+    // ! which the compiler can vectorize across the lanes of a block
+    static uint64_t popcount(uint64_t x) {
+#ifdef __POPCNT__
+        return static_cast<uint64_t>(__builtin_popcountll(x));
+#else
+        x = x - ((x >> 1) & 0x5555555555555555ULL);
+        x = (x & 0x3333333333333333ULL) + ((x >> 2) & 0x3333333333333333ULL);
+        x = (x + (x >> 4)) & 0x0f0f0f0f0f0f0f0fULL;
+        return (x * 0x0101010101010101ULL) >> 56;
+#endif
+    }
+
+    // ! Number of differing bits between the query and each row of a block
+    static void blockCounts(const uint64_t *block, const uint64_t *q, size_t nWords, uint64_t *counts) {
+#if defined(__AVX512F__) && defined(__AVX512VPOPCNTDQ__)
+        __m512i acc = _mm512_setzero_si512();
+
+        for(size_t w = 0; w < nWords; w++) {
+            __m512i x = _mm512_xor_si512(_mm512_load_si512(block + w * LANES), _mm512_set1_epi64(q[w]));
+            acc = _mm512_add_epi64(acc, _mm512_popcnt_epi64(x));
+        }
+
+        _mm512_storeu_si512(counts, acc);
+#elif defined(__AVX2__)
+        // population count of each nibble, summed per 64-bit lane
+        const __m256i lookup = _mm256_setr_epi8(0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4,
+                                                0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4);
+        const __m256i lowNibbles = _mm256_set1_epi8(0x0f);
+
+        for(size_t half = 0; half < LANES; half += 4) {
+            __m256i acc = _mm256_setzero_si256();
+
+            for(size_t w = 0; w < nWords; w++) {
+                __m256i x = _mm256_xor_si256(
+                    _mm256_load_si256(reinterpret_cast<const __m256i *>(block + w * LANES + half)),
+                    _mm256_set1_epi64x(static_cast<long long>(q[w])));
+                __m256i bytes = _mm256_add_epi8(
+                    _mm256_shuffle_epi8(lookup, _mm256_and_si256(x, lowNibbles)),
+                    _mm256_shuffle_epi8(lookup, _mm256_and_si256(_mm256_srli_epi16(x, 4), lowNibbles)));
+                acc = _mm256_add_epi64(acc, _mm256_sad_epu8(bytes, _mm256_setzero_si256()));
+            }
+
+            _mm256_storeu_si256(reinterpret_cast<__m256i *>(counts + half), acc);
+        }
+#else
+        for(size_t lane = 0; lane < LANES; lane++)
+            counts[lane] = 0;
+
+        for(size_t w = 0; w < nWords; w++)
+            for(size_t lane = 0; lane < LANES; lane++)
+                counts[lane] += popcount(block[w * LANES + lane] ^ q[w]);
+#endif
+    }
+
+public:
+
+    // ! Packs n rows with d categorical features each
+    PackedHammingIndex(const double *points, size_t n, size_t d) : SpatialIndex(points, n, d, HAMMING), values(d),
+                                                                   firstBit(d) {
+        size_t nBits = 0;
+
+        for(size_t j = 0; j < d; j++) {
+            values[j] = distinctValues(points, n, d, j);
+            firstBit[j] = nBits;
+
+            if(values[j].size() > 1)
+                nBits += values[j].size();
+        }
+
+        nWords = max<size_t>((nBits + 63) / 64, 1);
+        size_t nBlocks = (n + LANES - 1) / LANES;
+        packed.assign(nBlocks * nWords * LANES, 0);
+
+        #pragma omp parallel for if(n * d > 65536)
+        for(size_t i = 0; i < n; i++)
+            pack(point(i), &packed[(i / LANES) * nWords * LANES + i % LANES], LANES);
+    }
+
+    // ! Number of 64-bit words each packed row of a data set would take, found without packing it. Memory is that
+    // ! of the distinct values of one feature, so it can decide whether packing is worth it before the index,
+    // ! which grows with the product of the number of rows and of distinct values, is allocated
+    // ! \param points n rows with d features each
+    static size_t countWords(const double *points, size_t n, size_t d) {
+        size_t nBits = 0;
+
+        for(size_t j = 0; j < d; j++) {
+            size_t distinct = distinctValues(points, n, d, j).size();
+
+            if(distinct > 1)
+                nBits += distinct;
+        }
+
+        return max<size_t>((nBits + 63) / 64, 1);
+    }
+
+    // ! \return number of 64-bit words in each packed row
+    size_t wordsPerRow() const {
+        return nWords;
+    }
+
+    void query(const double *q, NeighborHeap &heap) const override {
+        vector<uint64_t> &packedQuery = queryWords();
+        packedQuery.assign(nWords, 0);
+        double correction = pack(q, packedQuery.data(), 1);
+        uint64_t counts[LANES];
+
+        for(size_t block = 0; block * LANES < n; block++) {
+            blockCounts(&packed[block * nWords * LANES], packedQuery.data(), nWords, counts);
+            size_t lanes = min<size_t>(LANES, n - block * LANES);
+            double worst = heap.worst();
+
+            // rows are visited in increasing order, so a row tied with the worst neighbor would lose the tie
+            for(size_t lane = 0; lane < lanes; lane++) {
+                double dist = (counts[lane] + correction) / 2;
+
+                if(dist < worst) {
+                    heap.offer(dist, block * LANES + lane);
+                    worst = heap.worst();
+                }
+            }
+        }
+    }
+};
+
+
+#endif // MACHINE_LEARNING_PACKEDHAMMING_HPP
@@ -0,0 +1,179 @@
+/**
+ * @author Douglas De Rizzo Meneghetti (douglasrizzom@gmail.com)
+ * @brief  QR decomposition by Householder reflections
+ * @date   2026-10-16
+ */
+
+#ifndef MACHINE_LEARNING_QR_HPP
+#define MACHINE_LEARNING_QR_HPP
+
+#include <vector>
+#include <cmath>
+#include <limits>
+#include <stdexcept>
+#include "../include/matrix/Matrix.hpp"
+#include "Gemm.hpp"
+
+using namespace std;
+
+
+/**
+ * QR decomposition, A = QR, of an m x n matrix with m >= n, by Householder reflections.
+ *
+ * Q is never formed. Its reflections are kept below the diagonal of R and applied to right-hand sides on demand,
+ * which makes the decomposition suited to least squares problems: min ||Ax - b|| is solved as Rx = Q'b, without
+ * forming A'A, whose condition number is the square of that of A. Memory is that of a copy of A.
+ */
+class QR {
+private:
+    size_t m, n;
+    // R above the diagonal, Householder vectors (without their first element) below it, row-major
+    vector<double> qr;
+    // first element of each Householder vector, scale of each reflection and the diagonal of R
+    vector<double> vHead, beta, rDiagonal;
+
+    double &at(size_t i, size_t j) {
+        return qr[i * n + j];
+    }
+
+    double at(size_t i, size_t j) const {
+        return qr[i * n + j];
+    }
+
+    // ! Applies reflection j, I - beta v v', to columns [c0, c1) of a row-major matrix with the given row stride.
+    // ! Rows are traversed once to compute v'x for all columns and once to update them
+    void reflect(size_t j, double *x, size_t stride, size_t c0, size_t c1) const {
+        if(beta[j] == 0)
+            return;
+
+        vector<double> dots(c1 - c0);
+
+        for(size_t c = c0; c < c1; c++)
+            dots[c - c0] = vHead[j] * x[j * stride + c];
+
+        for(size_t i = j + 1; i < m; i++) {
+            double vi = at(i, j);
+
+            for(size_t c = c0; c < c1; c++)
+                dots[c - c0] += vi * x[i * stride + c];
+        }
+
+        for(size_t c = c0; c < c1; c++)
+            dots[c - c0] *= beta[j];
+
+        for(size_t c = c0; c < c1; c++)
+            x[j * stride + c] -= dots[c - c0] * vHead[j];
+
+        #pragma omp parallel for if((m - j) * (c1 - c0) > 65536)
+        for(size_t i = j + 1; i < m; i++) {
+            double vi = at(i, j);
+
+            for(size_t c = c0; c < c1; c++)
+                x[i * stride + c] -= dots[c - c0] * vi;
+        }
+    }
+
+public:
+
+    // ! Factorizes a matrix with at least as many rows as columns
+    // ! \param a the matrix to be factorized
+    explicit QR(const MatrixD &a) : m(a.nRows()), n(a.nCols()), vHead(a.nCols()), beta(a.nCols()),
+                                    rDiagonal(a.nCols()) {
+        if(m < n)
+            throw invalid_argument("QR decomposition needs at least as many rows as columns");
+
+        const double *data = Gemm::data(a);
+        qr.assign(data, data + m * n);
+
+        for(size_t j = 0; j < n; j++) {
+            double norm = 0;
+
+            for(size_t i = j; i < m; i++)
+                norm += at(i, j) * at(i, j);
+
+            norm = sqrt(norm);
+
+            if(norm == 0) {
+                beta[j] = 0;
+                vHead[j] = 0;
+                rDiagonal[j] = 0;
+                continue;
+            }
+
+            // the sign is chosen so that v = x - alpha e1 does not cancel
+            double alpha = at(j, j) > 0 ? -norm : norm;
+            vHead[j] = at(j, j) - alpha;
+            beta[j] = -1 / (alpha * vHead[j]);
+            rDiagonal[j] = alpha;
+
+            reflect(j, qr.data(), n, j + 1, n);
+        }
+    }
+
+    // ! \return whether R has a diagonal element that is negligible relative to the largest one, in which case
+    // ! the columns of A are linearly dependent
+    bool isRankDeficient() const {
+        double largest = 0;
+
+        for(size_t j = 0; j < n; j++)
+            largest = max(largest, abs(rDiagonal[j]));
+
+        for(size_t j = 0; j < n; j++)
+            if(abs(rDiagonal[j]) <= largest * m * numeric_limits<double>::epsilon())
+                return true;
+
+        return false;
+    }
+
+    // ! Solves the least squares problem min ||AX - B||, one column of B at a time
+    // ! \param b a matrix with as many rows as A, each of its columns a right-hand side
+    // ! \return the n x k matrix X
+    MatrixD solve(const MatrixD &b) const {
+        if(b.nRows() != m)
+            throw invalid_argument(
+                "Cannot solve the system: A = " + to_string(m) + "x" + to_string(n) + ", B = "
+                + to_string(b.nRows()) + "x" + to_string(b.nCols()));
+
+        if(isRankDeficient())
+            throw runtime_error("Matrix is rank deficient");
+
+        size_t k = b.nCols();
+        vector<double> y(Gemm::data(b), Gemm::data(b) + m * k);
+
+        // Q'B
+        for(size_t j = 0; j < n; j++)
+            reflect(j, y.data(), k, 0, k);
+
+        // back substitution, RX = (Q'B)[0, n)
+        vector<double> x(n * k);
+
+        for(size_t i = n; i-- > 0;)
+            for(size_t c = 0; c < k; c++) {
+                double value = y[i * k + c];
+
+                for(size_t j = i + 1; j < n; j++)
+                    value -= at(i, j) * x[j * k + c];
+
+                x[i * k + c] = value / rDiagonal[i];
+            }
+
+        return MatrixD(n, k, x);
+    }
+
+    // ! \return the n x n upper triangular factor R
+    MatrixD getR() const {
+        MatrixD r = MatrixD::zeros(n, n);
+
+        for(size_t i = 0; i < n; i++) {
+            r(i, i) = rDiagonal[i];
+
+            for(size_t j = i + 1; j < n; j++)
+                r(i, j) = at(i, j);
+        }
+
+        return r;
+    }
+};
+
+
+#endif // MACHINE_LEARNING_QR_HPP
@@ -0,0 +1,679 @@
+/**
+ * @author Douglas De Rizzo Meneghetti (douglasrizzom@gmail.com)
+ * @brief  KD-tree and ball tree indices for exact k-nearest neighbor queries
+ * @date   2026-10-16
+ */
+
+#ifndef MACHINE_LEARNING_SPATIALINDEX_HPP
+#define MACHINE_LEARNING_SPATIALINDEX_HPP
+
+#include <vector>
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <utility>
+#include <random>
+#include <queue>
+
+using namespace std;
+
+
+/**
+ * Keeps the k best neighbor candidates seen so far in a max-heap, the worst candidate on top.
+ * Candidates are ordered by distance and then by index, so ties are always resolved in favor of the element that
+ * comes first in the data set, no matter in which order candidates are offered.
+ */
+class NeighborHeap {
+private:
+    size_t k;
+    vector<pair<double, size_t> > heap;
+public:
+
+    explicit NeighborHeap(size_t k = 1) : k(k) {
+        heap.reserve(k);
+    }
+
+    // ! Empties the heap, optionally changing its capacity
+    void reset(size_t k) {
+        this->k = k;
+        heap.clear();
+        heap.reserve(k);
+    }
+
+    bool full() const {
+        return heap.size() == k;
+    }
+
+    // ! \return maximum number of candidates kept
+    size_t capacity() const {
+        return k;
+    }
+
+    // ! \return distance of the worst candidate, or infinity while the heap is not full
+    double worst() const {
+        return full() ? heap.front().first : numeric_limits<double>::infinity();
+    }
+
+    // ! Offers a candidate, which is kept if the heap is not full or if it beats the worst candidate
+    void offer(double distance, size_t index) {
+        pair<double, size_t> candidate(distance, index);
+
+        if(!full()) {
+            heap.push_back(candidate);
+            push_heap(heap.begin(), heap.end());
+        } else if(candidate < heap.front()) {
+            pop_heap(heap.begin(), heap.end());
+            heap.back() = candidate;
+            push_heap(heap.begin(), heap.end());
+        }
+    }
+
+    // ! Sorts the candidates from closest to farthest. The heap must be reset before being used again
+    const vector<pair<double, size_t> > &sorted() {
+        sort_heap(heap.begin(), heap.end());
+        return heap;
+    }
+};
+
+/**
+ * Common interface of spatial indices built over n points with d features each, stored contiguously in row-major
+ * order. Indices only refer to the points, so the buffer must outlive them and must not be modified.
+ */
+class SpatialIndex {
+public:
+    enum Metric { EUCLIDEAN, HAMMING };
+
+protected:
+    const double *points;
+    size_t n, d;
+    Metric metric;
+    // points belonging to each node are contiguous ranges of this permutation
+    vector<size_t> order;
+    // maximum number of points in a leaf
+    enum { LEAF_SIZE = 16 };
+
+    SpatialIndex(const double *points, size_t n, size_t d, Metric metric) :
+        points(points), n(n), d(d), metric(metric), order(n) {
+        for(size_t i = 0; i < n; i++)
+            order[i] = i;
+    }
+
+    const double *point(size_t i) const {
+        return points + i * d;
+    }
+
+    // ! Brute-force search over the points order[begin, end)
+    void scan(const double *q, size_t begin, size_t end, NeighborHeap &heap) const {
+        for(size_t i = begin; i < end; i++)
+            heap.offer(distance(q, point(order[i])), order[i]);
+    }
+
+public:
+
+    virtual ~SpatialIndex() {}
+
+    // ! Squared Euclidean distance between two arrays of d values. The loop has no branches, so it is vectorized
+    static double squaredEuclidean(const double *a, const double *b, size_t d) {
+        double dist = 0;
+
+        #pragma omp simd reduction(+:dist)
+        for(size_t j = 0; j < d; j++)
+            dist += (a[j] - b[j]) * (a[j] - b[j]);
+
+        return dist;
+    }
+
+    // ! Number of positions in which two arrays of d values differ, computed without branches
+    static double hamming(const double *a, const double *b, size_t d) {
+        double dist = 0;
+
+        #pragma omp simd reduction(+:dist)
+        for(size_t j = 0; j < d; j++)
+            dist += static_cast<double>(a[j] != b[j]);
+
+        return dist;
+    }
+
+    // ! Distance between two points: Euclidean, or the number of features in which they differ
+    double distance(const double *a, const double *b) const {
+        return metric == EUCLIDEAN ? sqrt(squaredEuclidean(a, b, d)) : hamming(a, b, d);
+    }
+
+    // ! Finds the exact k nearest neighbors of a query point
+    // ! \param q pointer to the d features of the query point
+    // ! \param heap receives the neighbors, as pairs of (distance, point index)
+    virtual void query(const double *q, NeighborHeap &heap) const = 0;
+};
+
+/**
+ * KD-tree, which splits the space along the feature with the largest spread at each level.
+ * Queries descend to the leaf containing the query point and then visit the other children only when the distance
+ * to their half-space, maintained incrementally per feature, could still beat the current k-th neighbor.
+ * Best suited to data sets with few features.
+ */
+class KDTree : public SpatialIndex {
+private:
+    struct Node {
+        size_t begin, end, axis;
+        double split;
+        // children indices, or -1 in leaves
+        long left, right;
+    };
+
+    vector<Node> nodes;
+
+    long build(size_t begin, size_t end) {
+        Node node = {begin, end, 0, 0, -1, -1};
+        long id = static_cast<long>(nodes.size());
+        nodes.push_back(node);
+
+        if(end - begin <= LEAF_SIZE)
+            return id;
+
+        // split along the feature with the largest spread
+        double largestSpread = 0;
+        size_t axis = 0;
+
+        for(size_t j = 0; j < d; j++) {
+            double lo = point(order[begin])[j], hi = lo;
+
+            for(size_t i = begin + 1; i < end; i++) {
+                lo = min(lo, point(order[i])[j]);
+                hi = max(hi, point(order[i])[j]);
+            }
+
+            if(hi - lo > largestSpread) {
+                largestSpread = hi - lo;
+                axis = j;
+            }
+        }
+
+        // all points are equal, no split is possible
+        if(largestSpread == 0)
+            return id;
+
+        size_t mid = begin + (end - begin) / 2;
+        nth_element(order.begin() + begin, order.begin() + mid, order.begin() + end,
+            [this, axis](size_t a, size_t b) { return point(a)[axis] < point(b)[axis]; });
+
+        nodes[id].axis = axis;
+        nodes[id].split = point(order[mid])[axis];
+        long left = build(begin, mid), right = build(mid, end);
+        nodes[id].left = left;
+        nodes[id].right = right;
+        return id;
+    }
+
+    // ! Lower bound contribution of one feature to the distance between q and the other side of a split.
+    // ! Points on the left have values <= split and points on the right have values >= split
+    double offset(double qValue, double split) const {
+        return metric == EUCLIDEAN ? (qValue - split) * (qValue - split) : qValue != split;
+    }
+
+    // ! \param bound lower bound of the (squared, for Euclidean) distance from q to the region of the node
+    // ! \param offsets per-feature contributions to <code>bound</code>
+    void search(long id, const double *q, double bound, vector<double> &offsets, NeighborHeap &heap) const {
+        const Node &node = nodes[id];
+
+        if(node.left < 0) {
+            scan(q, node.begin, node.end, heap);
+            return;
+        }
+
+        bool goLeft = q[node.axis] < node.split;
+        long nearChild = goLeft ? node.left : node.right, farChild = goLeft ? node.right : node.left;
+
+        search(nearChild, q, bound, offsets, heap);
+
+        double oldOffset = offsets[node.axis], newOffset = offset(q[node.axis], node.split);
+        double farBound = bound - oldOffset + newOffset;
+        // the heap keeps true distances, so the squared Euclidean bound is compared against a squared worst.
+        // Squaring a square root may round down, so a little slack keeps exact ties from being pruned
+        double worst = heap.worst();
+
+        if(metric == EUCLIDEAN)
+            worst *= worst * (1 + 1e-12);
+
+        // ties are kept, since a tied candidate with a smaller index would still enter the heap
+        if(farBound <= worst) {
+            offsets[node.axis] = newOffset;
+            search(farChild, q, farBound, offsets, heap);
+            offsets[node.axis] = oldOffset;
+        }
+    }
+
+    // ! \return the offsets of the calling thread, so concurrent queries do not share them and consecutive ones
+    // ! reuse their memory
+    static vector<double> &queryOffsets() {
+        static thread_local vector<double> offsets;
+        return offsets;
+    }
+
+public:
+
+    // ! Builds a KD-tree over n points with d features each
+    KDTree(const double *points, size_t n, size_t d, Metric metric) : SpatialIndex(points, n, d, metric) {
+        if(n > 0)
+            build(0, n);
+    }
+
+    void query(const double *q, NeighborHeap &heap) const override {
+        if(nodes.empty())
+            return;
+
+        vector<double> &offsets = queryOffsets();
+        offsets.assign(d, 0);
+        search(0, q, 0, offsets, heap);
+    }
+};
+
+/**
+ * Ball tree, in which each node is a ball (a center and a radius) containing its points.
+ * By the triangle inequality, no point in a ball is closer to q than d(q, center) - radius, so balls farther than
+ * the current k-th neighbor are skipped. Unlike the KD-tree, its pruning does not degrade as quickly when the number
+ * of features grows. Centers are the mean of the points for the Euclidean distance and the most frequent value of
+ * each feature for the Hamming distance.
+ */
+class BallTree : public SpatialIndex {
+private:
+    struct Node {
+        size_t begin, end;
+        double radius;
+        long left, right;
+    };
+
+    vector<Node> nodes;
+    // node centers, d features each
+    vector<double> centers;
+
+    void computeCenter(size_t begin, size_t end, double *center) const {
+        size_t count = end - begin;
+
+        for(size_t j = 0; j < d; j++) {
+            if(metric == EUCLIDEAN) {
+                double sum = 0;
+
+                for(size_t i = begin; i < end; i++)
+                    sum += point(order[i])[j];
+
+                center[j] = sum / count;
+            } else {
+                vector<double> values(count);
+
+                for(size_t i = begin; i < end; i++)
+                    values[i - begin] = point(order[i])[j];
+
+                sort(values.begin(), values.end());
+
+                // most frequent value, ties resolved in favor of the smallest one
+                size_t bestRun = 0;
+
+                for(size_t i = 0, run; i < count; i += run) {
+                    for(run = 1; i + run < count and values[i + run] == values[i]; run++);
+
+                    if(run > bestRun) {
+                        bestRun = run;
+                        center[j] = values[i];
+                    }
+                }
+            }
+        }
+    }
+
+    // ! \return position in [begin, end) of the point farthest from <code>from</code>
+    size_t farthest(size_t begin, size_t end, const double *from) const {
+        size_t best = begin;
+        double bestDistance = -1;
+
+        for(size_t i = begin; i < end; i++) {
+            double dist = distance(from, point(order[i]));
+
+            if(dist > bestDistance) {
+                bestDistance = dist;
+                best = i;
+            }
+        }
+
+        return best;
+    }
+
+    long build(size_t begin, size_t end) {
+        Node node = {begin, end, 0, -1, -1};
+        long id = static_cast<long>(nodes.size());
+        nodes.push_back(node);
+        centers.resize(nodes.size() * d);
+        computeCenter(begin, end, &centers[id * d]);
+
+        double radius = 0;
+
+        for(size_t i = begin; i < end; i++)
+            radius = max(radius, distance(&centers[id * d], point(order[i])));
+
+        nodes[id].radius = radius;
+
+        if(end - begin <= LEAF_SIZE or radius == 0)
+            return id;
+
+        // two pivots far from each other; each point goes to the side of the closest one
+        size_t p1 = order[farthest(begin, end, &centers[id * d])];
+        size_t p2 = order[farthest(begin, end, point(p1))];
+        size_t mid = static_cast<size_t>(partition(order.begin() + begin, order.begin() + end,
+            [this, p1, p2](size_t i) {
+                return distance(point(i), point(p1)) <= distance(point(i), point(p2));
+            }) - order.begin());
+
+        // degenerate partitions are split in half
+        if(mid == begin or mid == end)
+            mid = begin + (end - begin) / 2;
+
+        long left = build(begin, mid), right = build(mid, end);
+        nodes[id].left = left;
+        nodes[id].right = right;
+        return id;
+    }
+
+    void search(long id, const double *q, double centerDistance, NeighborHeap &heap) const {
+        const Node &node = nodes[id];
+
+        // slack for the rounding of the center distance and the radius, so exact ties are never pruned
+        if(centerDistance - node.radius > heap.worst() * (1 + 1e-12))
+            return;
+
+        if(node.left < 0) {
+            scan(q, node.begin, node.end, heap);
+            return;
+        }
+
+        double leftDistance = distance(q, &centers[node.left * d]),
+               rightDistance = distance(q, &centers[node.right * d]);
+
+        // the child whose center is closer is more likely to contain the neighbors, so it is visited first
+        if(leftDistance <= rightDistance) {
+            search(node.left, q, leftDistance, heap);
+            search(node.right, q, rightDistance, heap);
+        } else {
+            search(node.right, q, rightDistance, heap);
+            search(node.left, q, leftDistance, heap);
+        }
+    }
+
+public:
+
+    // ! Builds a ball tree over n points with d features each
+    BallTree(const double *points, size_t n, size_t d, Metric metric) : SpatialIndex(points, n, d, metric) {
+        if(n > 0)
+            build(0, n);
+    }
+
+    void query(const double *q, NeighborHeap &heap) const override {
+        if(!nodes.empty())
+            search(0, q, distance(q, &centers[0]), heap);
+    }
+};
+
+/**
+ * Hierarchical Navigable Small World graph (Malkov and Yashunin, 2018), an approximate nearest neighbor index.
+ *
+ * Every point is a node in layer 0 and, with exponentially decreasing probability, in the layers above it. Each
+ * layer links a node to a few of its close neighbors, so upper layers are sparse and act as express lanes. A query
+ * descends greedily from the top layer to layer 1 and then explores layer 0 with a beam of width
+ * <code>efSearch</code>. Results are not guaranteed to be exact; recall grows with <code>M</code>,
+ * <code>efConstruction</code> and <code>efSearch</code>, and so do memory and time.
+ *
+ * Points are inserted one at a time, so the graph can grow after it is built.
+ */
+class HNSWGraph : public SpatialIndex {
+private:
+    // maximum number of links per node in the upper layers (M) and in layer 0 (2M)
+    size_t M, maxLinks0;
+    // width of the beam used when inserting and when querying
+    size_t efConstruction, efSearch;
+    // normalization of the level distribution, 1 / ln(M)
+    double levelMultiplier;
+
+    // links[i][l] are the neighbors of node i in layer l
+    vector<vector<vector<size_t> > > links;
+    size_t entryPoint;
+    int topLevel;
+    mt19937_64 generator;
+
+    typedef pair<double, size_t> Candidate;
+    typedef priority_queue<Candidate, vector<Candidate>, greater<Candidate> > ClosestFirst;
+    typedef priority_queue<Candidate> FarthestFirst;
+
+    // ! Distance used to rank points, which skips the square root of the Euclidean distance
+    double rankDistance(const double *a, const double *b) const {
+        return metric == EUCLIDEAN ? squaredEuclidean(a, b, d) : hamming(a, b, d);
+    }
+
+    // ! Nodes visited during a search. Marks are invalidated all at once by increasing the current generation,
+    // ! so searches neither allocate nor clear O(n) memory
+    struct VisitedSet {
+        vector<unsigned> marks;
+        unsigned generation;
+
+        VisitedSet() : generation(0) {}
+
+        void reset(size_t n) {
+            if(marks.size() < n)
+                marks.resize(n, 0);
+
+            if(++generation == 0) {
+                fill(marks.begin(), marks.end(), 0);
+                generation = 1;
+            }
+        }
+
+        // ! \return whether node i had not been visited yet
+        bool insert(size_t i) {
+            if(marks[i] == generation)
+                return false;
+
+            marks[i] = generation;
+            return true;
+        }
+    };
+
+    // ! \return the visited set of the calling thread, so concurrent queries do not share it
+    static VisitedSet &visitedSet() {
+        static thread_local VisitedSet visited;
+        return visited;
+    }
+
+    // ! Beam search in one layer
+    // ! \param q query point
+    // ! \param entries starting nodes and their distances to q
+    // ! \param ef width of the beam
+    // ! \param level layer to be searched
+    // ! \return up to ef nodes closest to q, sorted from the closest to the farthest
+    vector<Candidate> searchLayer(const double *q, const vector<Candidate> &entries, size_t ef, int level) const {
+        VisitedSet &visited = visitedSet();
+        visited.reset(n);
+        ClosestFirst candidates;
+        FarthestFirst results;
+
+        for(const Candidate &entry : entries) {
+            visited.insert(entry.second);
+            candidates.push(entry);
+            results.push(entry);
+        }
+
+        while(results.size() > ef)
+            results.pop();
+
+        while(!candidates.empty()) {
+            Candidate current = candidates.top();
+
+            // every candidate left is farther than the worst result
+            if(current.first > results.top().first and results.size() >= ef)
+                break;
+
+            candidates.pop();
+
+            for(size_t neighbor : links[current.second][level]) {
+                if(!visited.insert(neighbor))
+                    continue;
+
+                double dist = rankDistance(q, point(neighbor));
+
+                if(results.size() < ef or dist < results.top().first) {
+                    candidates.push(Candidate(dist, neighbor));
+                    results.push(Candidate(dist, neighbor));
+
+                    if(results.size() > ef)
+                        results.pop();
+                }
+            }
+        }
+
+        vector<Candidate> sorted(results.size());
+
+        for(size_t i = sorted.size(); i-- > 0; results.pop())
+            sorted[i] = results.top();
+
+        return sorted;
+    }
+
+    // ! Chooses the links of a node among candidates sorted by distance. A candidate is only linked if it is
+    // ! closer to the node than to every candidate already chosen, which spreads links in different directions
+    // ! \param candidates nodes sorted from the closest to the farthest
+    // ! \param maxLinks maximum number of links to keep
+    vector<size_t> selectNeighbors(const vector<Candidate> &candidates, size_t maxLinks) const {
+        vector<size_t> selected;
+
+        for(const Candidate &candidate : candidates) {
+            if(selected.size() >= maxLinks)
+                break;
+
+            bool diverse = true;
+
+            for(size_t chosen : selected)
+                if(rankDistance(point(candidate.second), point(chosen)) < candidate.first) {
+                    diverse = false;
+                    break;
+                }
+
+            if(diverse)
+                selected.push_back(candidate.second);
+        }
+
+        return selected;
+    }
+
+    // ! Descends greedily from the entry point down to the layer above <code>level</code>
+    Candidate descend(const double *q, int level) const {
+        Candidate current(rankDistance(q, point(entryPoint)), entryPoint);
+
+        for(int l = topLevel; l > level; l--) {
+            bool improved = true;
+
+            while(improved) {
+                improved = false;
+
+                for(size_t neighbor : links[current.second][l]) {
+                    double dist = rankDistance(q, point(neighbor));
+
+                    if(dist < current.first) {
+                        current = Candidate(dist, neighbor);
+                        improved = true;
+                    }
+                }
+            }
+        }
+
+        return current;
+    }
+
+    // ! Inserts node i, whose point is already in the buffer, into the graph
+    void insert(size_t i) {
+        int level = static_cast<int>(-log(uniform_real_distribution<double>(0, 1)(generator) + 1e-300)
+                                     * levelMultiplier);
+        links[i].assign(level + 1, vector<size_t>());
+
+        if(i == 0) {
+            entryPoint = 0;
+            topLevel = level;
+            return;
+        }
+
+        const double *q = point(i);
+        vector<Candidate> entries(1, descend(q, level));
+
+        for(int l = min(level, topLevel); l >= 0; l--) {
+            entries = searchLayer(q, entries, efConstruction, l);
+            size_t maxLinks = l == 0 ? maxLinks0 : M;
+            links[i][l] = selectNeighbors(entries, M);
+
+            for(size_t neighbor : links[i][l]) {
+                vector<size_t> &neighborLinks = links[neighbor][l];
+                neighborLinks.push_back(i);
+
+                // a neighbor with too many links keeps only the most diverse ones
+                if(neighborLinks.size() > maxLinks) {
+                    vector<Candidate> candidates;
+
+                    for(size_t other : neighborLinks)
+                        candidates.push_back(Candidate(rankDistance(point(neighbor), point(other)), other));
+
+                    sort(candidates.begin(), candidates.end());
+                    neighborLinks = selectNeighbors(candidates, maxLinks);
+                }
+            }
+        }
+
+        if(level > topLevel) {
+            topLevel = level;
+            entryPoint = i;
+        }
+    }
+
+public:
+
+    // ! Builds the graph by inserting n points with d features each, in order
+    // ! \param M maximum number of links per node in the upper layers; layer 0 allows 2M
+    // ! \param efConstruction width of the beam used to find the neighbors of inserted points
+    // ! \param efSearch width of the beam used by queries, raised to k when smaller than it
+    HNSWGraph(const double *points, size_t n, size_t d, Metric metric,
+        size_t M = 16, size_t efConstruction = 200, size_t efSearch = 50) :
+        SpatialIndex(points, 0, d, metric), M(max<size_t>(M, 2)), maxLinks0(2 * max<size_t>(M, 2)),
+        efConstruction(max<size_t>(efConstruction, 1)), efSearch(max<size_t>(efSearch, 1)),
+        levelMultiplier(1 / log(static_cast<double>(max<size_t>(M, 2)))), entryPoint(0), topLevel(-1),
+        generator(42) {
+        add(points, n);
+    }
+
+    // ! Inserts the points appended to the buffer since the graph was last updated
+    // ! \param points the buffer, which may have been reallocated
+    // ! \param n number of points now in the buffer
+    void add(const double *points, size_t n) {
+        this->points = points;
+        links.resize(n);
+
+        for(size_t i = this->n; i < n; i++) {
+            this->n = i + 1;
+            insert(i);
+        }
+    }
+
+    size_t getEfSearch() const {
+        return efSearch;
+    }
+
+    void setEfSearch(size_t efSearch) {
+        this->efSearch = max<size_t>(efSearch, 1);
+    }
+
+    void query(const double *q, NeighborHeap &heap) const override {
+        if(n == 0)
+            return;
+
+        vector<Candidate> entries(1, descend(q, 0));
+        size_t ef = max(efSearch, heap.capacity());
+
+        for(const Candidate &result : searchLayer(q, entries, ef, 0))
+            heap.offer(distance(q, point(result.second)), result.second);
+    }
+};
+
+
+#endif // MACHINE_LEARNING_SPATIALINDEX_HPP
@@ -0,0 +1,338 @@
+/**
+ * @author Douglas De Rizzo Meneghetti (douglasrizzom@gmail.com)
+ * @brief  Least squares over data sets read in batches
+ * @date   2026-10-16
+ */
+
+#ifndef MACHINE_LEARNING_STREAMINGLEASTSQUARES_HPP
+#define MACHINE_LEARNING_STREAMINGLEASTSQUARES_HPP
+
+#include <vector>
+#include <cmath>
+#include <stdexcept>
+#include "../include/matrix/Matrix.hpp"
+#include "MatrixView.hpp"
+#include "Gemm.hpp"
+#include "Cholesky.hpp"
+#include "LeastSquares.hpp"
+#include "BatchReader.hpp"
+
+using namespace std;
+
+
+/**
+ * Ordinary and weighted least squares that never keeps the data set in memory.
+ *
+ * Each batch of rows is reduced to the weighted means of its features and targets and to the sums of products of
+ * their deviations from those means. These are merged into running totals with the pairwise update of Chan, Golub
+ * and LeVeque, as in IncrementalPCA, so memory is bounded by d² whatever the number of elements, and targets or
+ * features with a large mean do not lose digits to cancellation. Totals filled by different threads or processes
+ * over different parts of the data set can be combined with merge() before calling solve(). The weights of weighted
+ * regression are computed as in LeastSquares.
+ */
+class StreamingLeastSquares {
+private:
+    // ! Weighted means of the features and targets of a set of elements and sums of products of the deviations
+    // ! from those means
+    struct Moments {
+        double weight;
+        vector<double> xMean, yMean;
+        // X'X (d x d) and X'y (d x t) of the deviations, and the diagonal of y'y (t)
+        MatrixD xx, xy;
+        vector<double> yy;
+
+        Moments() : weight(0) {}
+
+        Moments(size_t features, size_t targets) : weight(0), xMean(features, 0), yMean(targets, 0),
+                                                   xx(MatrixD::zeros(features, features)),
+                                                   xy(MatrixD::zeros(features, targets)), yy(targets, 0) {}
+
+        // ! Computes the moments of a batch, centering it by its own means first
+        // ! \param weights weight of each row
+        Moments(MatrixViewD data, MatrixViewD labels, const vector<double> &weights) :
+            Moments(data.nCols(), labels.nCols()) {
+            size_t m = data.nRows(), d = data.nCols(), t = labels.nCols();
+
+            for(size_t i = 0; i < m; i++)
+                weight += weights[i];
+
+            if(weight == 0)
+                return;
+
+            for(size_t i = 0; i < m; i++) {
+                for(size_t j = 0; j < d; j++)
+                    xMean[j] += weights[i] * data(i, j) / weight;
+
+                for(size_t j = 0; j < t; j++)
+                    yMean[j] += weights[i] * labels(i, j) / weight;
+            }
+
+            // deviations from the means, scaled by the square root of the weights
+            MatrixD x(m, d), y(m, t);
+            double *xd = Gemm::data(x), *yd = Gemm::data(y);
+
+            #pragma omp parallel for if(m * d > 65536)
+            for(size_t i = 0; i < m; i++) {
+                double root = sqrt(weights[i]);
+
+                for(size_t j = 0; j < d; j++)
+                    xd[i * d + j] = root * (data(i, j) - xMean[j]);
+
+                for(size_t j = 0; j < t; j++)
+                    yd[i * t + j] = root * (labels(i, j) - yMean[j]);
+            }
+
+            Gemm::gemm<double>(d, d, m, 1, xd, 1, d, xd, d, 1, 0, Gemm::data(xx), d);
+            Gemm::gemm<double>(d, t, m, 1, xd, 1, d, yd, t, 1, 0, Gemm::data(xy), t);
+
+            for(size_t i = 0; i < m; i++)
+                for(size_t j = 0; j < t; j++)
+                    yy[j] += yd[i * t + j] * yd[i * t + j];
+        }
+
+        // ! Adds the moments of other elements. Sums of products are shifted to the merged means by the difference
+        // ! between the means of both sets
+        void merge(const Moments &other) {
+            double total = weight + other.weight;
+
+            if(other.weight == 0)
+                return;
+
+            size_t d = xMean.size(), t = yMean.size();
+            double scale = weight * other.weight / total;
+            vector<double> xDelta(d), yDelta(t);
+
+            for(size_t j = 0; j < d; j++)
+                xDelta[j] = other.xMean[j] - xMean[j];
+
+            for(size_t j = 0; j < t; j++)
+                yDelta[j] = other.yMean[j] - yMean[j];
+
+            for(size_t i = 0; i < d; i++) {
+                for(size_t j = 0; j < d; j++)
+                    xx(i, j) += other.xx(i, j) + scale * xDelta[i] * xDelta[j];
+
+                for(size_t j = 0; j < t; j++)
+                    xy(i, j) += other.xy(i, j) + scale * xDelta[i] * yDelta[j];
+            }
+
+            for(size_t j = 0; j < t; j++)
+                yy[j] += other.yy[j] + scale * yDelta[j] * yDelta[j];
+
+            for(size_t j = 0; j < d; j++)
+                xMean[j] += xDelta[j] * other.weight / total;
+
+            for(size_t j = 0; j < t; j++)
+                yMean[j] += yDelta[j] * other.weight / total;
+
+            weight = total;
+        }
+    };
+
+    LeastSquares::RegressionType regressionType;
+    size_t nFeatures, nTargets;
+    unsigned long long nElements;
+    // moments under the weights of the regression, which define the coefficients, and unweighted moments, from
+    // which residuals are computed as LeastSquares does. Both are the same in ordinary least squares, so the
+    // unweighted ones are only kept by weighted regression
+    Moments weighted, unweighted;
+    MatrixD coefs, residuals;
+    double ridge;
+
+    void initialize(size_t features, size_t targets) {
+        nFeatures = features;
+        nTargets = targets;
+        weighted = Moments(features, targets);
+
+        if(regressionType == LeastSquares::WEIGHTED)
+            unweighted = Moments(features, targets);
+    }
+
+public:
+
+    // ! \param regType whether each element is weighted by the variance of its values, as in LeastSquares
+    explicit StreamingLeastSquares(LeastSquares::RegressionType regType = LeastSquares::REGULAR) :
+        regressionType(regType), nFeatures(0), nTargets(0), nElements(0), ridge(0) {}
+
+    /**
+     * Adds a batch of elements to the model
+     * @param data a Matrix, or a view of one, with elements in rows and features in columns
+     * @param labels a Matrix, or a view of one, with the target values of each element in its rows
+     */
+    void partialFit(MatrixViewD data, MatrixViewD labels) {
+        if(data.nRows() != labels.nRows())
+            throw invalid_argument("data and labels must have the same number of rows");
+
+        if(data.isEmpty())
+            return;
+
+        if(nElements == 0)
+            initialize(data.nCols(), labels.nCols());
+        else if(data.nCols() != nFeatures or labels.nCols() != nTargets)
+            throw invalid_argument("Batch has " + to_string(data.nCols()) + " features and " + to_string(labels.nCols())
+                                   + " targets, but the model was fit on " + to_string(nFeatures) + " and "
+                                   + to_string(nTargets));
+
+        size_t m = data.nRows(), d = nFeatures + 1;
+        vector<double> ones(m, 1), weights = ones;
+
+        // the weight of an element is the variance of its values, the intercept included
+        if(regressionType == LeastSquares::WEIGHTED) {
+            #pragma omp parallel for if(m * d > 65536)
+            for(size_t i = 0; i < m; i++) {
+                double mean = 1, var = 0;
+
+                for(size_t j = 0; j < nFeatures; j++)
+                    mean += data(i, j);
+
+                mean /= d;
+                var = (1 - mean) * (1 - mean);
+
+                for(size_t j = 0; j < nFeatures; j++)
+                    var += (data(i, j) - mean) * (data(i, j) - mean);
+
+                weights[i] = var / (d - 1);
+            }
+
+            unweighted.merge(Moments(data, labels, ones));
+        }
+
+        weighted.merge(Moments(data, labels, weights));
+        nElements += m;
+    }
+
+    /**
+     * Fits the model to a data set read in batches, such as a file larger than the available memory
+     * @param source a CSVBatchReader, a MatrixBatchReader or any object with the same next() method
+     * @param labelColumn index of the column that holds the target value; all other columns are features
+     * @param batchSize number of elements read at a time
+     */
+    template<typename Source>
+    void fitStream(Source &source, size_t labelColumn, size_t batchSize = 4096) {
+        MatrixD batch;
+
+        while(source.next(batchSize, batch)) {
+            if(labelColumn >= batch.nCols())
+                throw invalid_argument("Label column is out of range");
+
+            MatrixViewD view(batch);
+            MatrixD features(batch.nRows(), batch.nCols() - 1);
+
+            for(size_t i = 0; i < batch.nRows(); i++)
+                for(size_t j = 0, k = 0; j < batch.nCols(); j++)
+                    if(j != labelColumn)
+                        features(i, k++) = batch(i, j);
+
+            partialFit(features, view.col(labelColumn));
+        }
+    }
+
+    // ! Adds the moments accumulated by another object, fit on other elements of the same data set
+    void merge(const StreamingLeastSquares &other) {
+        if(other.nElements == 0)
+            return;
+
+        if(other.regressionType != regressionType)
+            throw invalid_argument("Cannot merge ordinary and weighted regression models");
+
+        if(nElements == 0)
+            initialize(other.nFeatures, other.nTargets);
+        else if(other.nFeatures != nFeatures or other.nTargets != nTargets)
+            throw invalid_argument("Cannot merge models fit on a different number of features or targets");
+
+        weighted.merge(other.weighted);
+        unweighted.merge(other.unweighted);
+        nElements += other.nElements;
+    }
+
+    // ! Solves the accumulated normal equations. With centered moments, the slopes solve (Sxx + ridge) B = Sxy by
+    // ! the Cholesky decomposition and the intercept is mean(y) - mean(x)'B, which leaves it unpenalized. The sum of
+    // ! squared residuals is computed from the unweighted moments, Syy - 2B'Sxy + B'SxxB plus the squared residual
+    // ! of the means, so that it is the same as that of LeastSquares
+    void solve() {
+        if(nElements == 0)
+            throw runtime_error("No elements were added to the model");
+
+        if(weighted.weight == 0)
+            throw runtime_error("Elements added to the model have no weight");
+
+        MatrixD penalized = weighted.xx;
+
+        for(size_t j = 0; j < nFeatures; j++)
+            penalized(j, j) += ridge;
+
+        MatrixD slopes = Cholesky(penalized).solve(weighted.xy);
+        coefs = MatrixD(nFeatures + 1, nTargets);
+
+        for(size_t c = 0; c < nTargets; c++) {
+            coefs(0, c) = weighted.yMean[c];
+
+            for(size_t j = 0; j < nFeatures; j++) {
+                coefs(0, c) -= weighted.xMean[j] * slopes(j, c);
+                coefs(j + 1, c) = slopes(j, c);
+            }
+        }
+
+        const Moments &moments = regressionType == LeastSquares::WEIGHTED ? unweighted : weighted;
+        MatrixD xxSlopes = Gemm::multiply(moments.xx, slopes);
+        residuals = MatrixD(1, nTargets);
+
+        for(size_t c = 0; c < nTargets; c++) {
+            // residual of the mean element, which is zero for ordinary least squares
+            double meanResidual = moments.yMean[c] - coefs(0, c), sse = moments.yy[c];
+
+            for(size_t j = 0; j < nFeatures; j++) {
+                meanResidual -= moments.xMean[j] * slopes(j, c);
+                sse += slopes(j, c) * (xxSlopes(j, c) - 2 * moments.xy(j, c));
+            }
+
+            residuals(0, c) = max(sse + moments.weight * meanResidual * meanResidual, 0.0);
+        }
+    }
+
+    // ! \return predictions for elements in the rows of m, without copying them to add the intercept column
+    MatrixD predict(MatrixViewD m) const {
+        if(m.nCols() != nFeatures or coefs.nRows() != nFeatures + 1)
+            throw runtime_error("Model has not been solved for elements with " + to_string(m.nCols()) + " features");
+
+        MatrixD result(m.nRows(), nTargets);
+
+        for(size_t i = 0; i < m.nRows(); i++)
+            for(size_t c = 0; c < nTargets; c++)
+                result(i, c) = coefs(0, c);
+
+        Gemm::gemm<double>(m.nRows(), nTargets, nFeatures, 1, m.data(), m.rowStride(), m.colStride(),
+                           Gemm::data(coefs) + nTargets, nTargets, 1, 1, Gemm::data(result), nTargets);
+
+        return result;
+    }
+
+    // ! Sets the ridge penalty, lambda ||B||², added to the squared residuals. The intercept is not penalized
+    void setRidge(double ridge) {
+        if(ridge < 0)
+            throw invalid_argument("Ridge penalty must not be negative");
+
+        this->ridge = ridge;
+    }
+
+    double getRidge() const {
+        return ridge;
+    }
+
+    unsigned long long getNElements() const {
+        return nElements;
+    }
+
+    // ! \return (d + 1) x t matrix of coefficients, the intercept in the first row
+    const MatrixD &getCoefs() const {
+        return coefs;
+    }
+
+    // ! \return sum of squared residuals of each target. As in LeastSquares, residuals are not weighted
+    const MatrixD &getResiduals() const {
+        return residuals;
+    }
+};
+
+
+#endif // MACHINE_LEARNING_STREAMINGLEASTSQUARES_HPP
@@ -0,0 +1,429 @@
+/**
+ * @author Douglas De Rizzo Meneghetti (douglasrizzom@gmail.com)
+ * @brief  Eigenvalues and eigenvectors of symmetric matrices
+ * @date   2026-10-16
+ */
+
+#ifndef MACHINE_LEARNING_SYMMETRICEIGEN_HPP
+#define MACHINE_LEARNING_SYMMETRICEIGEN_HPP
+
+#include <vector>
+#include <cmath>
+#include <limits>
+#include <algorithm>
+#include <stdexcept>
+#include "../include/matrix/Matrix.hpp"
+#include "Gemm.hpp"
+
+using namespace std;
+
+
+/**
+ * Eigendecomposition of a symmetric matrix, A = V diag(lambda) V'.
+ *
+ * The matrix is first reduced to tridiagonal form by n - 2 Householder reflections, in O(n³), accumulating the
+ * reflections into an orthogonal matrix Q. Eigenvalues of the tridiagonal matrix are then found by the QL algorithm
+ * with implicit Wilkinson shifts, which takes O(n) per iteration and converges in a few iterations per eigenvalue.
+ *
+ * When all eigenvectors are requested, the rotations of the QL algorithm are applied to Q as they are made. When
+ * only the eigenvectors of the m largest eigenvalues are requested, eigenvalues are found without rotating Q and
+ * each selected eigenvector of the tridiagonal matrix is computed by inverse iteration in O(n), then mapped back
+ * through Q with a single n x n x m GEMM.
+ *
+ * Eigenvalues are sorted in decreasing order, like <code>Matrix::eigen()</code>. The QL algorithm throws if an
+ * eigenvalue does not converge, instead of returning an approximation.
+ */
+class SymmetricEigen {
+private:
+    // iterations of the QL algorithm allowed for each eigenvalue and iterations of inverse iteration
+    // performed for each eigenvector
+    enum { MAX_QL_ITERATIONS = 60, INVERSE_ITERATIONS = 3 };
+
+    size_t n;
+    // orthogonal matrix of the Householder reduction, which becomes the matrix of eigenvectors, row-major
+    vector<double> V;
+    // diagonal and subdiagonal of the tridiagonal matrix; e[i] is the element at (i, i - 1)
+    vector<double> d, e;
+    MatrixD eigenvalues, eigenvectors;
+
+    double &v(size_t i, size_t j) {
+        return V[i * n + j];
+    }
+
+    // ! Householder reduction of V, which holds the symmetric matrix, to tridiagonal form. On exit, d and e hold
+    // ! the tridiagonal matrix and V the orthogonal matrix Q of the reduction, so that Q' A Q is tridiagonal
+    void tridiagonalize() {
+        for(size_t j = 0; j < n; j++)
+            d[j] = v(n - 1, j);
+
+        for(size_t i = n - 1; i > 0; i--) {
+            double scale = 0, h = 0;
+
+            for(size_t k = 0; k < i; k++)
+                scale += abs(d[k]);
+
+            if(scale == 0) {
+                // row already reduced
+                e[i] = d[i - 1];
+
+                for(size_t j = 0; j < i; j++) {
+                    d[j] = v(i - 1, j);
+                    v(i, j) = 0;
+                    v(j, i) = 0;
+                }
+            } else {
+                // Householder vector that zeroes the elements of row i to the left of the subdiagonal
+                for(size_t k = 0; k < i; k++) {
+                    d[k] /= scale;
+                    h += d[k] * d[k];
+                }
+
+                double f = d[i - 1], g = sqrt(h);
+
+                if(f > 0)
+                    g = -g;
+
+                e[i] = scale * g;
+                h -= f * g;
+                d[i - 1] = f - g;
+
+                for(size_t j = 0; j < i; j++)
+                    e[j] = 0;
+
+                // e = A u / h, using the lower triangle of the unreduced block
+                for(size_t j = 0; j < i; j++) {
+                    f = d[j];
+                    v(j, i) = f;
+                    g = e[j] + v(j, j) * f;
+
+                    for(size_t k = j + 1; k < i; k++) {
+                        g += v(k, j) * d[k];
+                        e[k] += v(k, j) * f;
+                    }
+
+                    e[j] = g;
+                }
+
+                f = 0;
+
+                for(size_t j = 0; j < i; j++) {
+                    e[j] /= h;
+                    f += e[j] * d[j];
+                }
+
+                double hh = f / (h + h);
+
+                for(size_t j = 0; j < i; j++)
+                    e[j] -= hh * d[j];
+
+                // rank-2 update of the unreduced block, A - u e' - e u'
+                for(size_t j = 0; j < i; j++) {
+                    f = d[j];
+                    g = e[j];
+
+                    for(size_t k = j; k < i; k++)
+                        v(k, j) -= f * e[k] + g * d[k];
+
+                    d[j] = v(i - 1, j);
+                    v(i, j) = 0;
+                }
+            }
+
+            d[i] = h;
+        }
+
+        // accumulate the reflections into Q
+        for(size_t i = 0; i + 1 < n; i++) {
+            v(n - 1, i) = v(i, i);
+            v(i, i) = 1;
+            double h = d[i + 1];
+
+            if(h != 0) {
+                for(size_t k = 0; k <= i; k++)
+                    d[k] = v(k, i + 1) / h;
+
+                for(size_t j = 0; j <= i; j++) {
+                    double g = 0;
+
+                    for(size_t k = 0; k <= i; k++)
+                        g += v(k, i + 1) * v(k, j);
+
+                    for(size_t k = 0; k <= i; k++)
+                        v(k, j) -= g * d[k];
+                }
+            }
+
+            for(size_t k = 0; k <= i; k++)
+                v(k, i + 1) = 0;
+        }
+
+        for(size_t j = 0; j < n; j++) {
+            d[j] = v(n - 1, j);
+            v(n - 1, j) = 0;
+        }
+
+        v(n - 1, n - 1) = 1;
+        e[0] = 0;
+    }
+
+    // ! QL algorithm with implicit shifts over the tridiagonal matrix in d and e. On exit, d holds the eigenvalues,
+    // ! unsorted. If vectors is true, the rotations are also applied to the columns of V
+    void diagonalize(bool vectors) {
+        for(size_t i = 1; i < n; i++)
+            e[i - 1] = e[i];
+
+        e[n - 1] = 0;
+
+        double f = 0, norm = 0, eps = numeric_limits<double>::epsilon();
+
+        for(size_t l = 0; l < n; l++) {
+            // find a negligible subdiagonal element, which splits the matrix
+            norm = max(norm, abs(d[l]) + abs(e[l]));
+            size_t m = l;
+
+            while(m < n - 1 and abs(e[m]) > eps * norm)
+                m++;
+
+            unsigned int iterations = 0;
+
+            while(m > l) {
+                if(++iterations > MAX_QL_ITERATIONS)
+                    throw runtime_error("Eigenvalues did not converge");
+
+                // Wilkinson shift, from the leading 2 x 2 block
+                double g = d[l], p = (d[l + 1] - g) / (2 * e[l]), r = hypot(p, 1.0);
+
+                if(p < 0)
+                    r = -r;
+
+                d[l] = e[l] / (p + r);
+                d[l + 1] = e[l] * (p + r);
+                double dl1 = d[l + 1], h = g - d[l];
+
+                for(size_t i = l + 2; i < n; i++)
+                    d[i] -= h;
+
+                f += h;
+
+                // implicit QL step, chasing the bulge with plane rotations
+                p = d[m];
+                double c = 1, c2 = c, c3 = c, el1 = e[l + 1], s = 0, s2 = 0;
+
+                for(size_t i = m; i-- > l;) {
+                    c3 = c2;
+                    c2 = c;
+                    s2 = s;
+                    g = c * e[i];
+                    h = c * p;
+                    r = hypot(p, e[i]);
+                    e[i + 1] = s * r;
+                    s = e[i] / r;
+                    c = p / r;
+                    p = c * d[i] - s * g;
+                    d[i + 1] = h + s * (c * g + s * d[i]);
+
+                    if(vectors)
+                        for(size_t k = 0; k < n; k++) {
+                            double *row = &V[k * n];
+                            h = row[i + 1];
+                            row[i + 1] = s * row[i] + c * h;
+                            row[i] = c * row[i] - s * h;
+                        }
+                }
+
+                p = -s * s2 * c3 * el1 * e[l] / dl1;
+                e[l] = s * p;
+                d[l] = c * p;
+
+                if(abs(e[l]) <= eps * norm)
+                    break;
+            }
+
+            d[l] += f;
+            e[l] = 0;
+        }
+    }
+
+    // ! Eigenvector of the tridiagonal matrix (diagonal, subdiagonal) for an eigenvalue, by inverse iteration.
+    // ! The shifted matrix is factorized once with partial pivoting and the system is solved a few times, each
+    // ! solution orthogonalized against the eigenvectors already found for nearby eigenvalues
+    // ! \param diagonal diagonal of the tridiagonal matrix
+    // ! \param subdiagonal subdiagonal, subdiagonal[i] being the element at (i, i - 1)
+    // ! \param lambda the eigenvalue
+    // ! \param cluster eigenvectors of eigenvalues close to lambda, each of size n
+    // ! \param x receives the eigenvector, with unit norm
+    void inverseIteration(const vector<double> &diagonal, const vector<double> &subdiagonal, double lambda,
+                          const vector<const double *> &cluster, double tiny, vector<double> &x) const {
+        // LU factorization of T - lambda I with partial pivoting. U has two superdiagonals after row swaps
+        vector<double> u0(n), u1(n, 0), u2(n, 0), multipliers(n, 0);
+        vector<char> swapped(n, 0);
+
+        for(size_t i = 0; i < n; i++)
+            u0[i] = diagonal[i] - lambda;
+
+        for(size_t i = 0; i + 1 < n; i++)
+            u1[i] = subdiagonal[i + 1];
+
+        for(size_t i = 0; i + 1 < n; i++) {
+            double below = subdiagonal[i + 1];
+
+            if(abs(u0[i]) >= abs(below)) {
+                if(u0[i] == 0)
+                    u0[i] = tiny;
+
+                multipliers[i] = below / u0[i];
+                u0[i + 1] -= multipliers[i] * u1[i];
+            } else {
+                // row i + 1 becomes the pivot row
+                double nextDiagonal = u0[i + 1], nextSuper = u1[i + 1];
+                multipliers[i] = u0[i] / below;
+                swapped[i] = 1;
+                u0[i + 1] = u1[i] - multipliers[i] * nextDiagonal;
+                u1[i + 1] = -multipliers[i] * nextSuper;
+                u0[i] = below;
+                u1[i] = nextDiagonal;
+                u2[i] = nextSuper;
+            }
+        }
+
+        if(u0[n - 1] == 0)
+            u0[n - 1] = tiny;
+
+        // a starting vector with components along every eigenvector
+        for(size_t i = 0; i < n; i++)
+            x[i] = 1 + 0.5 * sin(static_cast<double>(i) + 1);
+
+        for(unsigned int iteration = 0; iteration < INVERSE_ITERATIONS; iteration++) {
+            for(size_t i = 0; i + 1 < n; i++) {
+                if(swapped[i])
+                    swap(x[i], x[i + 1]);
+
+                x[i + 1] -= multipliers[i] * x[i];
+            }
+
+            for(size_t i = n; i-- > 0;) {
+                double sum = x[i];
+
+                if(i + 1 < n)
+                    sum -= u1[i] * x[i + 1];
+
+                if(i + 2 < n)
+                    sum -= u2[i] * x[i + 2];
+
+                x[i] = sum / u0[i];
+            }
+
+            for(const double *other : cluster) {
+                double dot = 0;
+
+                for(size_t i = 0; i < n; i++)
+                    dot += other[i] * x[i];
+
+                for(size_t i = 0; i < n; i++)
+                    x[i] -= dot * other[i];
+            }
+
+            double norm = 0;
+
+            for(size_t i = 0; i < n; i++)
+                norm += x[i] * x[i];
+
+            norm = sqrt(norm);
+
+            for(size_t i = 0; i < n; i++)
+                x[i] /= norm;
+        }
+    }
+
+public:
+
+    /**
+     * Finds the eigenvalues and eigenvectors of a symmetric matrix. Only the lower triangle is read
+     * @param a a symmetric matrix
+     * @param count number of eigenvectors to be computed, those of the largest eigenvalues. 0 computes all of them
+     */
+    explicit SymmetricEigen(const MatrixD &a, size_t count = 0) : n(a.nRows()) {
+        if(a.nRows() != a.nCols())
+            throw invalid_argument("Matrix must be square");
+
+        if(count == 0 or count > n)
+            count = n;
+
+        if(n == 0)
+            return;
+
+        V.assign(Gemm::data(a), Gemm::data(a) + n * n);
+        d.resize(n);
+        e.resize(n);
+
+        tridiagonalize();
+
+        bool partial = count < n;
+        vector<double> diagonal, subdiagonal;
+
+        if(partial) {
+            diagonal = d;
+            subdiagonal = e;
+        }
+
+        diagonalize(!partial);
+
+        vector<size_t> order(n);
+
+        for(size_t i = 0; i < n; i++)
+            order[i] = i;
+
+        stable_sort(order.begin(), order.end(), [this](size_t i, size_t j) { return d[i] > d[j]; });
+
+        eigenvalues = MatrixD(n, 1);
+
+        for(size_t i = 0; i < n; i++)
+            eigenvalues(i, 0) = d[order[i]];
+
+        eigenvectors = MatrixD(n, count);
+
+        if(!partial) {
+            for(size_t i = 0; i < n; i++)
+                for(size_t c = 0; c < count; c++)
+                    eigenvectors(i, c) = V[i * n + order[c]];
+
+            return;
+        }
+
+        // eigenvectors of the tridiagonal matrix, in rows, mapped back through Q with one GEMM
+        double norm = 0;
+
+        for(size_t i = 0; i < n; i++)
+            norm = max(norm, abs(diagonal[i]) + abs(subdiagonal[i]) + (i + 1 < n ? abs(subdiagonal[i + 1]) : 0));
+
+        double tiny = max(norm, numeric_limits<double>::min()) * numeric_limits<double>::epsilon(),
+               clusterGap = 1e-3 * norm;
+        vector<double> Z(count * n), x(n);
+
+        for(size_t c = 0; c < count; c++) {
+            vector<const double *> cluster;
+
+            for(size_t previous = 0; previous < c; previous++)
+                if(abs(eigenvalues(previous, 0) - eigenvalues(c, 0)) <= clusterGap)
+                    cluster.push_back(&Z[previous * n]);
+
+            inverseIteration(diagonal, subdiagonal, eigenvalues(c, 0), cluster, tiny, x);
+            copy(x.begin(), x.end(), Z.begin() + c * n);
+        }
+
+        Gemm::gemm<double>(n, count, n, 1, V.data(), n, 1, Z.data(), 1, n, 0, Gemm::data(eigenvectors), count);
+    }
+
+    // ! \return column vector with all eigenvalues, in decreasing order
+    const MatrixD &getEigenvalues() const {
+        return eigenvalues;
+    }
+
+    // ! \return matrix whose columns are the eigenvectors of the largest eigenvalues, in the same order
+    const MatrixD &getEigenvectors() const {
+        return eigenvectors;
+    }
+};
+
+
+#endif // MACHINE_LEARNING_SYMMETRICEIGEN_HPP
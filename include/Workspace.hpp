@@ -0,0 +1,93 @@
+/**
+ * @author Douglas De Rizzo Meneghetti (douglasrizzom@gmail.com)
+ * @brief  Arena of preallocated buffers for loops that must not allocate
+ * @date   2026-10-16
+ */
+
+#ifndef MACHINE_LEARNING_WORKSPACE_HPP
+#define MACHINE_LEARNING_WORKSPACE_HPP
+
+#include <atomic>
+#include <stdexcept>
+#include <string>
+#include "AlignedAllocator.hpp"
+
+using namespace std;
+
+
+// ! Counts the blocks allocated by every Workspace, whatever its element type
+class WorkspaceCounter {
+protected:
+    static atomic<unsigned long long> &counter() {
+        static atomic<unsigned long long> allocations(0);
+        return allocations;
+    }
+
+public:
+    // ! \return number of times any workspace of the process allocated memory. Sampling it before and after a
+    // ! loop tells whether the loop allocated
+    static unsigned long long allocations() {
+        return counter().load();
+    }
+};
+
+/**
+ * Arena that hands out buffers carved from a single block.
+ *
+ * The block is sized once with reserve(), from the sizes of all buffers a computation will need. take() then returns
+ * consecutive slices of it, each starting at a cache line, and release() returns all of them at once, so the same
+ * buffers are handed out again on the next round without touching the heap. The block only grows when reserve() is
+ * asked for more than its capacity, and every growth is counted.
+ * @tparam T type of the elements of the buffers
+ */
+template<typename T>
+class Workspace : public WorkspaceCounter {
+private:
+    // number of elements in a cache line, the granularity of the slices
+    enum { LINE = 64 / sizeof(T) > 0 ? 64 / sizeof(T) : 1 };
+
+    AlignedVector<T> block;
+    size_t used;
+
+public:
+
+    Workspace() : used(0) {}
+
+    // ! \return number of elements a buffer of the given size takes from the block, padding included
+    static size_t footprint(size_t size) {
+        return (size + LINE - 1) / LINE * LINE;
+    }
+
+    // ! Makes room for buffers whose footprints add up to the given number of elements. Releases all buffers
+    void reserve(size_t size) {
+        used = 0;
+
+        if(size <= block.size())
+            return;
+
+        block = AlignedVector<T>(size);
+        counter()++;
+    }
+
+    // ! \return a buffer with room for the given number of elements, whose values are left as they were
+    T *take(size_t size) {
+        if(used + footprint(size) > block.size())
+            throw runtime_error("Workspace has no room for a buffer of " + to_string(size) + " elements");
+
+        T *buffer = block.data() + used;
+        used += footprint(size);
+        return buffer;
+    }
+
+    // ! Returns all buffers to the workspace, to be taken again
+    void release() {
+        used = 0;
+    }
+
+    size_t capacity() const {
+        return block.size();
+    }
+};
+
+
+#endif // MACHINE_LEARNING_WORKSPACE_HPP
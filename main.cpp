@@ -6,13 +6,18 @@
 #include "include/KNN.hpp"
 #include "include/matrix/Matrix.hpp"
 #include "include/LeastSquares.hpp"
+#include "include/StreamingLeastSquares.hpp"
 #include "include/PCA.hpp"
+#include "include/IncrementalPCA.hpp"
 #include "include/LDA.hpp"
 #include "include/KMeans.hpp"
+#include "include/MiniBatchKMeans.hpp"
 #include "include/MLP.hpp"
 #include "include/ClassifierUtils.hpp"
 #include "include/NaiveBayes.hpp"
 #include "include/GridWorld.hpp"
+#include "include/Gemm.hpp"
+#include "include/LU.hpp"
 
 using namespace std;
 using myClock = chrono::high_resolution_clock;
@@ -196,6 +201,55 @@ void testWine(const string &path) {
     }
 }
 
+void testHNSW() {
+    MersenneTwister twister;
+    size_t n = 100000, nTest = 1000, d = 16, k = 10;
+
+    // clustered data, the last column being the dependent variable
+    vector<vector<double> > data(n), test(nTest);
+
+    for(size_t i = 0; i < n + nTest; i++) {
+        vector<double> row = twister.vecFromNormal(d, i % 20, 1);
+        row.push_back(i % 20);
+        (i < n ? data[i] : test[i - n]) = row;
+    }
+
+    KNN exact(data, d, k, KNN::EUCLIDEAN, KNN::BRUTE_FORCE);
+    vector<vector<size_t> > trueNeighbors(nTest);
+
+    chrono::time_point<chrono::system_clock> start = myClock::now();
+
+    for(size_t i = 0; i < nTest; i++)
+        trueNeighbors[i] = exact.getNeighbors(test[i]);
+
+    double exactSeconds = ((chrono::duration<double>)(myClock::now() - start)).count();
+
+    start = myClock::now();
+    KNN approximate(data, d, k, KNN::EUCLIDEAN, KNN::HNSW);
+    double buildSeconds = ((chrono::duration<double>)(myClock::now() - start)).count();
+
+    cout << "brute force: " << exactSeconds / nTest * 1000 << " ms/query" << endl
+         << "HNSW build: " << buildSeconds << "s" << endl
+         << "efSearch\tms/query\trecall@" << k << endl;
+
+    for(size_t efSearch : {10, 20, 50, 100, 200}) {
+        approximate.setEfSearch(efSearch);
+        size_t hits = 0;
+
+        start = myClock::now();
+
+        for(size_t i = 0; i < nTest; i++) {
+            vector<size_t> neighbors = approximate.getNeighbors(test[i]);
+
+            for(size_t neighbor : neighbors)
+                hits += count(trueNeighbors[i].begin(), trueNeighbors[i].end(), neighbor);
+        }
+
+        double seconds = ((chrono::duration<double>)(myClock::now() - start)).count();
+        cout << efSearch << '\t' << seconds / nTest * 1000 << '\t' << hits / double(nTest * k) << endl;
+    }
+}
+
 void testMatrixFromCSV() {
     MatrixD m = MatrixD::fromCSV(datasetDir + "alpswater/alpswater.csv");
     cout << m;
@@ -213,9 +267,106 @@ void testEigen() {
     cout << val << endl << vec;
 }
 
+void testGemm() {
+    MersenneTwister twister;
+    // square and tall-skinny shapes, as m x k times k x n
+    vector<array<size_t, 3> > shapes = {{{256, 256, 256}},
+                                        {{512, 512, 512}},
+                                        {{1024, 1024, 1024}},
+                                        {{100000, 64, 16}},
+                                        {{100000, 16, 64}},
+                                        {{64, 100000, 64}}};
+
+    cout << "m\tk\tn\tnaive GFLOP/s\tgemm GFLOP/s\tmax abs diff" << endl;
+
+    for(auto shape : shapes) {
+        size_t m = shape[0], k = shape[1], n = shape[2];
+        MatrixD a(m, k, twister.vecFromUniform(m * k, -1, 1));
+        MatrixD b(k, n, twister.vecFromUniform(k * n, -1, 1));
+        double flops = 2.0 * m * n * k;
+
+        chrono::time_point<chrono::system_clock> start = myClock::now();
+        MatrixD naive = a * b;
+        double naiveSeconds = ((chrono::duration<double>)(myClock::now() - start)).count();
+
+        start = myClock::now();
+        MatrixD blocked = Gemm::multiply(a, b);
+        double gemmSeconds = ((chrono::duration<double>)(myClock::now() - start)).count();
+
+        double maxDiff = 0;
+
+        for(size_t i = 0; i < m; i++)
+            for(size_t j = 0; j < n; j++)
+                maxDiff = max(maxDiff, abs(naive(i, j) - blocked(i, j)));
+
+        cout << m << '\t' << k << '\t' << n << '\t'
+             << flops / naiveSeconds / 1e9 << '\t' << flops / gemmSeconds / 1e9 << '\t' << maxDiff << endl;
+    }
+}
+
+void testLU() {
+    MersenneTwister twister;
+
+    // compare against cofactor expansion, which is only feasible for small matrices
+    MatrixD small(7, 7, twister.vecFromUniform(49, -1, 1));
+    LU smallLU(small);
+    cout << "determinant: " << small.determinant() << '\t' << smallLU.determinant() << endl
+         << "log |determinant|: " << smallLU.logDeterminant() << endl;
+
+    MatrixD inverseDiff = small.inverse() - smallLU.inverse();
+    cout << "max abs inverse diff: " << max(abs(inverseDiff.min()), abs(inverseDiff.max())) << endl;
+
+    for(size_t n : {100, 500, 1000}) {
+        MatrixD a(n, n, twister.vecFromUniform(n * n, -1, 1));
+        MatrixD b(n, 1, twister.vecFromUniform(n, -1, 1));
+
+        chrono::time_point<chrono::system_clock> start = myClock::now();
+        MatrixD x = LU(a).solve(b);
+        double seconds = ((chrono::duration<double>)(myClock::now() - start)).count();
+
+        MatrixD residual = Gemm::multiply(a, x) - b;
+        cout << n << "\tsolve time: " << seconds << "s\tmax abs residual: "
+             << max(abs(residual.min()), abs(residual.max())) << endl;
+    }
+}
+
+void testMetrics() {
+    MersenneTwister twister;
+    size_t n = 20000, m = 100, d = 16;
+    MatrixD a(n, d, twister.vecFromUniform(n * d, -1, 1));
+    MatrixD b(m, d, twister.vecFromUniform(m * d, -1, 1));
+
+    cout << "p\tnaive time\tengine time\tmax abs diff" << endl;
+
+    for(double p : {1.0, 2.0, 3.0}) {
+        chrono::time_point<chrono::system_clock> start = myClock::now();
+        MatrixD naive = MatrixD::zeros(n, m);
+
+        for(size_t i = 0; i < n; i++)
+            for(size_t j = 0; j < m; j++) {
+                for(size_t k = 0; k < d; k++)
+                    naive(i, j) += pow(abs(a(i, k) - b(j, k)), p);
+
+                naive(i, j) = pow(naive(i, j), 1 / p);
+            }
+
+        double naiveSeconds = ((chrono::duration<double>)(myClock::now() - start)).count();
+
+        start = myClock::now();
+        MatrixD engine = Metrics::minkowski(a, b, p);
+        double engineSeconds = ((chrono::duration<double>)(myClock::now() - start)).count();
+
+        MatrixD diff = naive - engine;
+        cout << p << '\t' << naiveSeconds << "s\t" << engineSeconds << "s\t"
+             << max(abs(diff.min()), abs(diff.max())) << endl;
+    }
+}
+
 void testMatrices() {
     // testOperations();
     // testInverseDeterminant();
+    // testLU();
+    // testMetrics();
     // testAddRowColumn();
     // testMatrixFromCSV();
     testEigen();
@@ -298,10 +449,19 @@ void testLeastSquaresCensus() {
     cout << "Coefficients" << endl << l.getCoefs() << "Residuals" << endl << l.getResiduals();
 }
 
+void testStreamingLeastSquaresCensus() {
+    StreamingLeastSquares l;
+    CSVBatchReader reader(datasetDir + "us-census/training.csv");
+    l.fitStream(reader, 1, 4);
+    l.solve();
+    cout << "Coefficients" << endl << l.getCoefs() << "Residuals" << endl << l.getResiduals();
+}
+
 void testLeastSquares() {
     testLeastSquaresAlps();
     testLeastSquaresBooks();
     testLeastSquaresCensus();
+    // testStreamingLeastSquaresCensus();
 }
 
 void testPCALindsay() {
@@ -381,6 +541,28 @@ void testPCAIris() {
     cout << pca.transform(2);
 }
 
+void testPCARandomizedIris() {
+    MatrixD data = MatrixD::fromCSV(datasetDir + "iris/original.csv");
+    data.removeColumn(4);
+
+    PCA pca(data);
+    pca.fit(2);
+
+    cout << pca.getEigenvalues().transpose() << pca.getPercentages().transpose() * 100
+         << pca.getCumPercentages().transpose() * 100 << endl;
+    cout << pca.transform();
+}
+
+void testIncrementalPCACensus() {
+    IncrementalPCA pca;
+    CSVBatchReader reader(datasetDir + "us-census/training.csv");
+    pca.fitStream(reader, 16);
+
+    cout << pca.getEigenvalues().transpose() << pca.getPercentages().transpose() * 100
+         << pca.getCumPercentages().transpose() * 100 << endl;
+    cout << pca.transform(MatrixD::fromCSV(datasetDir + "us-census/training.csv"), 2);
+}
+
 void testMDFIris() {
     MatrixD data = MatrixD::fromCSV(datasetDir + "iris/original.csv");
 
@@ -400,6 +582,8 @@ void testMDFIris() {
 void testLDA() {
     // testLDAIris();
     // testPCAIris();
+    // testPCARandomizedIris();
+    // testIncrementalPCACensus();
     testMDFIris();
 }
 
@@ -449,9 +633,53 @@ void testGiantToyDatasets() {
     myfile.close();
 }
 
+void testMiniBatchKMeans() {
+    MiniBatchKMeans kmeans(15, 1024);
+    CSVBatchReader reader(datasetDir + "synth-clustering/s-set.csv");
+
+    myClock::time_point start = myClock::now();
+    kmeans.fitStream(reader, 5);
+    myClock::time_point end = myClock::now();
+
+    cout << "Elements seen: " << kmeans.getSeenElements() << endl;
+    cout << "SSE of the last batch: " << kmeans.getBatchSSE() << endl;
+    cout << "Time: " << chrono::duration_cast<chrono::milliseconds>(end - start).count() << " ms" << endl;
+    cout << kmeans.getCentroids();
+}
+
+void testKMeansAssignmentMethods() {
+    MersenneTwister twister;
+    // without well separated clusters, centroids take many iterations to settle and only some of them move in the
+    // last ones, which exercises the bounds of the accelerated methods
+    size_t n = 50000, d = 8, clusters = 12;
+    MatrixD data(n, d, twister.vecFromNormal(n * d));
+
+    vector<KMeans::AssignmentMethod> methods = {KMeans::LLOYD, KMeans::HAMERLY, KMeans::ELKAN};
+    vector<MatrixD> labels;
+
+    for(KMeans::AssignmentMethod method : methods) {
+        KMeans kmeans(method);
+        kmeans.setSeed(7);
+        kmeans.fit(data, clusters, 1000, 1);
+        labels.push_back(kmeans.getY());
+        cout << "method " << method << ": " << kmeans.getTotalIterations() << " iterations, "
+             << kmeans.getDistanceComputations() << " distance computations, SSE " << kmeans.getSse() << endl;
+    }
+
+    for(size_t m = 1; m < labels.size(); m++)
+        for(size_t i = 0; i < n; i++)
+            if(labels[m](i, 0) != labels[0](i, 0))
+                throw runtime_error("Assignment method " + to_string(methods[m]) + " labeled element "
+                                    + to_string(i) + " differently from Lloyd's algorithm");
+
+    cout << "All assignment methods found the same clusters" << endl;
+}
+
 void testKMeans() {
+    // testKMeansAssignmentMethods();
     // testKMeansToyDataset();
     // testKMeansIris();
+    // testMiniBatchKMeans();
     testGiantToyDatasets();
 }
 
@@ -682,6 +910,7 @@ int main() {
     // testBooks();
     // testIris();
     // testPoker();
+    // testHNSW();
     // string red_path = datasetDir + "winequality-red/";
     // string white_path = datasetDir + "winequality-white/";
     // testWine(red_path);
@@ -695,6 +924,7 @@ int main() {
     // testNaiveBayes();
     testDynamicProgramming();
     // testBigOperations();
+    // testGemm();
     // sanityCheck();
     return 0;
 }